@@ -1,18 +1,52 @@
 #include <opencv/cv.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/opencv_modules.hpp>
 #include <cstdio>
 #include <vector>
 #include "helper/bounding_box.h"
-#include "train/tracker_trainer.h"
+#include "helper/image_proc.h"
 #include <sys/stat.h>
 #include <cxxopts.hpp>
 #include <dirent.h>
+#include <unistd.h>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <thread>
+#include "annotation-canvas.h"
+#include "annotation-file.h"
+#include "annotation-journal.h"
+#include "dataset-index.h"
+#include "deploy-graph.h"
+#include "frame-cache.h"
+#include "frame-export.h"
+#include "frame-extractor.h"
+#include "frame-pack.h"
+#include "frame-source.h"
+#include "flow-tracker.h"
+#include "goturn-tracker.h"
+#include "inference-device.h"
+#include "int8-calibration.h"
+#include "low-rank-model.h"
+#include "native-network.h"
+#include "network-input.h"
+#include "segment-tracker.h"
+#include "staged-frames.h"
+#include "tracker-backend.h"
+#include "tracker-worker.h"
+#include "video-frame-source.h"
+#ifdef USE_CAFFE
+#include "caffe-regressor.h"
+#endif
+#ifdef HAVE_OPENCV_DNN
+#include "dnn-regressor.h"
+#endif
 
-cv::Mat3b canvas;
+AnnotationCanvas canvas;
 bool toogleplay;
 cv::Point start;
 bool selected;
@@ -22,14 +56,27 @@ bool nextframe = false;
 bool manual = false;
 bool autostage = false;
 
-std::unique_ptr<Tracker> tracker = nullptr;
-std::unique_ptr<Regressor> regressor = nullptr;
+std::unique_ptr<BoxRegressor> regressor = nullptr;
+std::unique_ptr<TimedRegressor> timedregressor = nullptr;
+std::unique_ptr<TrackerBackend> trackerbackend = nullptr;
+std::unique_ptr<TrackerWorker> trackerworker = nullptr;
 
 BoundingBox _bbox;
 
-std::vector<std::string> frames;
-std::vector<BoundingBox> staged;
-std::vector<BoundingBox> unstaged;
+std::unique_ptr<FrameCache> framesource;
+
+/// Boxes of an annotated object, one per frame
+struct ObjectTrack
+{
+    std::vector<BoundingBox> staged;
+    std::vector<BoundingBox> unstaged;
+    /// Staged frames of staged, kept up to date by stageBox() and rebuilt by indexStaged() after bulk changes
+    StagedFrames index;
+};
+
+/// Objects annotated in the sequence, the edits apply to the current one
+std::vector<ObjectTrack> objects;
+int currobject = 0;
 std::vector<int> movieid;
 cv::Mat frame;
 int currframe;
@@ -37,6 +84,10 @@ int currframe;
 int firstframe = 0;
 int lastframe = -1;
 
+/// Write-ahead journal of the staged boxes, kept only in the GUI
+std::unique_ptr<AnnotationJournal> journal;
+std::string journalpath = "";
+
 std::string videoname = "";
 std::string framesdir = "";
 std::string outputdir = "";
@@ -46,7 +97,56 @@ std::string caffemodel = "../nets/tracker.caffemodel";
 
 int waitkeyduration = 1;
 
+int extractionthreads = std::thread::hardware_concurrency();
+int exportthreads = std::thread::hardware_concurrency();
+std::string framestore = "jpeg";
+
+bool directvideo = false;
+int seeksegment = 32;
+
+int framecachemb = 512;
+int readahead = 16;
+
+ExportOptions exportoptions;
+int playdirection = 1;
+
+std::string devicename = defaultInferenceDevice();
+InferenceDevice device;
+int cputhreads = 0;
+
+/// Names of the inference backends available in the build, the first one is the default
+std::vector<std::string> availableBackends()
+{
+    std::vector<std::string> backends;
+#ifdef USE_CAFFE
+    backends.push_back("caffe");
+#endif
+#ifdef HAVE_OPENCV_DNN
+    backends.push_back("dnn");
+#endif
+    backends.push_back("native");
+    return backends;
+}
+
+std::string backendname = availableBackends().front();
+std::string regressorname;
+std::string int8calibration = "";
+bool fullgraph = false;
+
+bool headless = false;
+
 bool toggletracking = true;
+int trackahead = 100;
+int checkpointmb = 256;
+int maxdecodescale = 8;
+int segmentthreads = std::thread::hardware_concurrency();
+std::string gapfilling = "linear";
+
+std::string trackername = "goturn";
+
+/// Regressors and tracker backends of the segment tracking workers, created on first use
+std::vector<std::unique_ptr<BoxRegressor>> segmentregressors;
+std::vector<std::unique_ptr<TrackerBackend>> segmentbackends;
 
 bool fileAccessible(std::string filename)
 {
@@ -54,72 +154,64 @@ bool fileAccessible(std::string filename)
     return file.good();
 }
 
-bool checkExtension(const char *name, const char *ext)
-{
-    return (strlen(name) >= strlen(ext)) && (!strcmp(name + strlen(name) - strlen(ext), ext));
-}
-
-int getFiles(std::string directory,
-                std::vector<std::string> &files, const char *ext)
+/// The .ann file of the object, numbered from 1 when the sequence has more objects
+std::string annotationsFile(int object)
 {
-    DIR *dp;
-    struct dirent *ep;
-    dp = opendir(directory.c_str());
-    if (dp != NULL)
-    {
-        ep = readdir(dp);
-        while (ep != NULL)
-        {
-            if (!ext || checkExtension(ep->d_name, ext))
-            {
-                if (strcmp(".", ep->d_name) != 0 &&
-                    strcmp("..", ep->d_name) != 0)
-                        files.push_back(directory + ep->d_name);
-            }
-            ep = readdir(dp);
-        }
-        closedir(dp);
-    }
-    else return -ENOENT;
-    return 0;
+    std::string range = std::to_string(firstframe) + "-" + std::to_string(lastframe);
+    if (objects.size() == 1) return outputdir + "annotations" + range + ".ann";
+    return outputdir + "annotations" + range + "-object" + std::to_string(object + 1) + ".ann";
 }
 
 int saveVideo()
 {
-    for (int i = firstframe; i < lastframe; i++)
+    for (size_t object = 0; object < objects.size(); object++)
     {
-        if (staged[i].x1_ == 0 && staged[i].x2_ == 0 && staged[i].y1_ == 0 && staged[i].y2_ == 0)
+        const StagedFrames &index = objects[object].index;
+        if (!index.allStaged(firstframe, lastframe - 1))
         {
-            printf("Not all frames within range are staged\n");
+            printf("Not all frames within range are staged for object %d, frame %d is not\n", (int)object + 1, index.firstUnstaged(firstframe, lastframe - 1));
             return 1;
         }
     }
-    std::string annotationsfile = outputdir + "annotations" + std::to_string(firstframe) + "-" + std::to_string(lastframe) + ".ann";
-    std::ofstream annotations(annotationsfile);
-    int count = 1;
-    for (int i = firstframe; i < lastframe; i++)
+    exportoptions.threads = exportthreads;
+    if (exportFrames(*framesource, firstframe, lastframe, outputdir, exportoptions) != 0) return 1;
+
+    // the annotations follow the frames resized on export
+    double scalex = 1.0, scaley = 1.0;
+    if (exportoptions.width > 0 || exportoptions.height > 0)
     {
-        annotations << count << " "
-            << staged[i].x1_ + 1 << " " << staged[i].y1_ + 1 << " "
-            << staged[i].x2_ + 1 << " " << staged[i].y1_ + 1 << " "
-            << staged[i].x1_ + 1 << " " << staged[i].y2_ + 1 << " "
-            << staged[i].x2_ + 1 << " " << staged[i].y2_ + 1 << std::endl;
-        std::ostringstream path;
-        path << outputdir;
-        path << std::setfill('0') << std::setw(8) << count;
-        path << ".jpg";
-        cv::Mat tosave = cv::imread(frames[i]);
-        cv::imwrite(path.str(), tosave);
-        count++;
+        cv::Size size = framesource->read(firstframe).size();
+        cv::Size exported = exportedSize(size, exportoptions);
+        scalex = (double)exported.width / size.width;
+        scaley = (double)exported.height / size.height;
     }
-    annotations.close();
 
-    printf("Annotations saved to %s\n", annotationsfile.c_str());
+    // the frames are shared, each object gets its own annotations
+    for (size_t object = 0; object < objects.size(); object++)
+    {
+        const std::vector<BoundingBox> &staged = objects[object].staged;
+        std::string annotationsfile = annotationsFile(object);
+        std::ofstream annotations(annotationsfile);
+        int count = 1;
+        for (int i = firstframe; i < lastframe; i++)
+        {
+            double x1 = staged[i].x1_ * scalex + 1, y1 = staged[i].y1_ * scaley + 1;
+            double x2 = staged[i].x2_ * scalex + 1, y2 = staged[i].y2_ * scaley + 1;
+            annotations << count << " "
+                << x1 << " " << y1 << " "
+                << x2 << " " << y1 << " "
+                << x1 << " " << y2 << " "
+                << x2 << " " << y2 << std::endl;
+            count++;
+        }
+        annotations.close();
+        printf("Annotations saved to %s\n", annotationsfile.c_str());
+    }
 
     return 0;
 }
 
-void interpolateStagedFrames(int from, int to)
+void interpolateStagedFrames(std::vector<BoundingBox> &staged, int from, int to)
 {
     printf("Interpolating from %d to %d\n", from, to);
     if (!(from < to && to - from > 1))
@@ -138,54 +230,219 @@ void interpolateStagedFrames(int from, int to)
     }
 }
 
-int loadAnnotations(std::string inputannotations)
+/**
+ * Loads the boxes of an object from a .ann or a binary annotations file into
+ * staged. The frames skipped in the file are interpolated linearly and added
+ * to gaps.
+ */
+int loadAnnotations(std::string inputannotations, std::vector<BoundingBox> &staged, std::vector<TrackingGap> &gaps)
 {
-    std::ifstream annotations(inputannotations);
+    AnnotationFile annotations;
+    if (annotations.open(inputannotations) != 0) return 1;
 
-    if (!annotations.good())
-    {
-        printf("Annotations file not available\n");
-        return 1;
-    }
+    const float *ids = annotations.column(ANNOTATION_ID);
+    const float *ax = annotations.column(ANNOTATION_AX), *ay = annotations.column(ANNOTATION_AY);
+    const float *bx = annotations.column(ANNOTATION_BX), *by = annotations.column(ANNOTATION_BY);
+    const float *cx = annotations.column(ANNOTATION_CX), *cy = annotations.column(ANNOTATION_CY);
+    const float *dx = annotations.column(ANNOTATION_DX), *dy = annotations.column(ANNOTATION_DY);
 
     int currid = firstframe;
     int previd = firstframe;
-    int prevannid = -1;
-
-    int annid;
-    int step = 1;
-    double Ax, Ay, Bx, By, Cx, Cy, Dx, Dy;
-
-    while (currid < lastframe)
+    size_t row = 0;
+    for (; row < annotations.rows() && currid < lastframe; row++)
     {
-        printf("Processing frame %d\n", currid);
-        if (annotations >> annid >> Ax >> Ay >> Bx >> By >> Cx >> Cy >> Dx >> Dy)
+        if (row > 0) currid += (int)ids[row] - (int)ids[row - 1];
+        if (currid < 0 || currid >= (int)staged.size())
         {
-            printf("%d %f %f %f %f %f %f %f %f\n", annid, Ax, Ay, Bx, By, Cx, Cy, Dx, Dy);
-            if (prevannid == -1) currid = firstframe;
-            else
-            {
-                int step = annid - prevannid;
-                currid += step;
-            }
-            staged[currid].x1_ = std::min(Ax, std::min(Bx, std::min(Cx, Dx))) - 1;
-            staged[currid].y1_ = std::min(Ay, std::min(By, std::min(Cy, Dy))) - 1;
-            staged[currid].x2_ = std::max(Ax, std::max(Bx, std::max(Cx, Dx))) - 1;
-            staged[currid].y2_ = std::max(Ay, std::max(By, std::max(Cy, Dy))) - 1;
-            if (currid - previd > 1) interpolateStagedFrames(previd, currid);
-            previd = currid;
-            prevannid = annid;
+            printf("Annotation of frame %d is outside of the sequence\n", (int)ids[row]);
+            return 1;
         }
-        else
+        staged[currid].x1_ = std::min(ax[row], std::min(bx[row], std::min(cx[row], dx[row]))) - 1;
+        staged[currid].y1_ = std::min(ay[row], std::min(by[row], std::min(cy[row], dy[row]))) - 1;
+        staged[currid].x2_ = std::max(ax[row], std::max(bx[row], std::max(cx[row], dx[row]))) - 1;
+        staged[currid].y2_ = std::max(ay[row], std::max(by[row], std::max(cy[row], dy[row]))) - 1;
+        if (currid - previd > 1)
         {
-            printf("Finished loading annotations\n");
-            annotations.close();
-            return 0;
+            interpolateStagedFrames(staged, previd, currid);
+            gaps.push_back({previd, currid});
         }
+        previd = currid;
+    }
+    printf("Loaded %d boxes from %s\n", (int)row, inputannotations.c_str());
+    return 0;
+}
+
+/**
+ * Converts the annotation files to the format (text or binary), the
+ * converted files are written to OUTPUT_DIRECTORY. Returns 0 on success.
+ */
+int convertAnnotations(const std::vector<std::string> &files, const std::string &format)
+{
+    if (format != "text" && format != "binary")
+    {
+        printf("Unknown annotations format:  %s\n", format.c_str());
+        return 1;
+    }
+    for (const std::string &file : files)
+    {
+        AnnotationFile annotations;
+        if (annotations.open(file) != 0) return 1;
+        std::string name = file.substr(file.rfind('/') + 1);
+        name = name.substr(0, name.rfind('.'));
+        std::string converted = outputdir + name + (format == "binary" ? BINARY_ANNOTATIONS_EXTENSION : ".ann");
+        int status = format == "binary" ? writeBinaryAnnotations(converted, annotations) : writeTextAnnotations(converted, annotations);
+        if (status != 0) return status;
+        printf("Converted %d boxes from %s to %s\n", (int)annotations.rows(), file.c_str(), converted.c_str());
     }
     return 0;
 }
 
+void loadCurrentFrame()
+{
+    if (canvas.frameIndex() == currframe && frame.data) return;
+    frame = framesource->read(currframe);
+    canvas.setFrame(currframe, frame);
+}
+
+/// Stages the box of the object in the frame, the change is appended to the journal
+void stageBox(int object, int frame, const BoundingBox &box)
+{
+    BoundingBox &staged = objects[object].staged[frame];
+    if (staged.x1_ == box.x1_ && staged.y1_ == box.y1_ && staged.x2_ == box.x2_ && staged.y2_ == box.y2_) return;
+    staged = box;
+    objects[object].index.update(frame, box);
+    if (journal) journal->stage(object, frame, box);
+}
+
+/// Stages the boxes of the object from first to last frame at once, the changes are appended to the journal
+void stageBoxes(int object, int first, int last, const std::vector<BoundingBox> &boxes)
+{
+    if (journal) journal->stage(object, first, last, boxes);
+    std::copy(boxes.begin() + first, boxes.begin() + last + 1, objects[object].staged.begin() + first);
+    objects[object].index.update(first, last, boxes);
+}
+
+/// Sets the first and the last frame of the saved range, the change is appended to the journal
+void setRange(int first, int last)
+{
+    if (first < 0 || first > last || last >= framesource->size())
+    {
+        printf("Frames %d-%d are not a valid range\n", first, last);
+        return;
+    }
+    firstframe = first;
+    lastframe = last;
+    if (journal) journal->setRange(first, last);
+}
+
+/// Returns true if the tracker worker is still computing a proposal of the current frame
+bool proposalsPending()
+{
+    for (size_t object = 0; object < objects.size(); object++)
+    {
+        if (trackerworker->pending(object, currframe)) return true;
+    }
+    return false;
+}
+
+void updateProposal()
+{
+    trackerworker->setPlayhead(currframe);
+    for (size_t object = 0; object < objects.size(); object++) trackerworker->collect(object, objects[object].unstaged);
+    if (!(selected && nextframe)) return;
+    if (!toggletracking)
+    {
+        nextframe = false;
+        return;
+    }
+    // the proposals are taken over once the tracker worker computes them for all objects
+    BoundingBox proposal;
+    if (proposalsPending() || !trackerworker->proposal(currobject, currframe, proposal)) return;
+    printf("Frame:  %d\n", currframe);
+    nextframe = false;
+    for (size_t object = 0; object < objects.size(); object++)
+    {
+        if (!trackerworker->proposal(object, currframe, proposal)) continue;
+        objects[object].unstaged[currframe] = proposal;
+        if (autostage) stageBox(object, currframe, proposal);
+    }
+}
+
+void refreshView()
+{
+    loadCurrentFrame();
+    BoundingBox fullframe({0, 0, (float)frame.cols, (float)frame.rows});
+    std::vector<Overlay> overlays;
+    // the other objects are dimmed, the current one is drawn on top of them
+    for (size_t object = 0; object < objects.size(); object++)
+    {
+        if ((int)object == currobject) continue;
+        overlays.push_back({objects[object].unstaged[currframe], 128, 0, 0});
+        overlays.push_back({objects[object].staged[currframe], 128, 128, 128});
+    }
+    overlays.push_back({objects[currobject].unstaged[currframe], 255, 0, 0});
+    overlays.push_back({objects[currobject].staged[currframe], 255, 255, 255});
+    if (firstframe == currframe) overlays.push_back({fullframe, 0, 255, 0});
+    if (lastframe == currframe) overlays.push_back({fullframe, 0, 0, 255});
+    canvas.setOverlays(overlays);
+    // the canvas is shown again only if anything has changed
+    if (canvas.compose()) cv::imshow("Frame", canvas.image());
+}
+
+/// Adds an object without boxes to the sequence, returns its index
+int addObject()
+{
+    BoundingBox empty;
+    empty.x1_ = 0;
+    empty.x2_ = 0;
+    empty.y1_ = 0;
+    empty.y2_ = 0;
+    ObjectTrack object;
+    object.staged.resize(framesource->size(), empty);
+    object.unstaged.resize(framesource->size(), empty);
+    object.index.resize(framesource->size());
+    objects.push_back(object);
+    if (trackerworker) trackerworker->addObject();
+    if (journal) journal->addObject();
+    return objects.size() - 1;
+}
+
+/// Rebuilds the staged frame indices after the staged boxes were replaced in bulk
+void indexStaged()
+{
+    for (ObjectTrack &object : objects) object.index.rebuild(object.staged);
+}
+
+/**
+ * Opens the journal of the session. The objects, staged boxes and range are
+ * restored from an existing journal, replacing the input annotations, and
+ * a new journal starts with the current state. Returns 0 on success.
+ */
+int openJournal()
+{
+    journal = std::unique_ptr<AnnotationJournal>(new AnnotationJournal());
+    if (journal->open(journalpath, framesource->size()) != 0) return 1;
+    if (!journal->restored())
+    {
+        AnnotationState state;
+        state.firstframe = firstframe;
+        state.lastframe = lastframe;
+        for (const ObjectTrack &object : objects) state.staged.push_back(object.staged);
+        return journal->reset(state);
+    }
+    const AnnotationState &state = journal->state();
+    objects.resize(state.staged.size());
+    for (size_t object = 0; object < objects.size(); object++)
+    {
+        objects[object].staged = state.staged[object];
+        objects[object].unstaged = state.staged[object];
+    }
+    firstframe = state.firstframe;
+    lastframe = state.lastframe;
+    printf("Restored %d objects and frames %d-%d from %s\n", (int)objects.size(), firstframe, lastframe, journalpath.c_str());
+    return 0;
+}
+
 void callbackfunc(int event, int x, int y, int flags, void* userdata)
 {
     if (event == cv::EVENT_LBUTTONDOWN)
@@ -222,48 +479,57 @@ void callbackfunc(int event, int x, int y, int flags, void* userdata)
         _bbox.x2_ = bbox[2];
         _bbox.y2_ = bbox[3];
         printf("Initializing tracking... ");
-        tracker->Init(frame, _bbox, regressor.get());
+        trackerworker->reset(currobject, currframe, _bbox);
         printf("Initialized.\n");
         toogleplay = true;
         selected = true;
         nextframe = true;
+        // the main loop may be blocked waiting for a key, update the view here
+        updateProposal();
+        journal->flush();
+        refreshView();
     }
 }
 
+int trackKeyframeSegments();
+int fillStagedGaps();
+
 bool keyboardControl(int key)
 {
+    std::vector<BoundingBox> &staged = objects[currobject].staged;
+    std::vector<BoundingBox> &unstaged = objects[currobject].unstaged;
     switch (key)
     {
     case 27: // ESC - quit
         return false;
     case 32: // SPACE - toggle pause/play
         paused = !paused;
+        playdirection = 1;
         break;
     case 106: // J - move backwards
         if (paused)
         {
             if (currframe > 0) currframe--;
+            playdirection = -1;
             nextframe = true;
         }
         break;
     case 107: // K - move forward
         if (paused)
         {
-            if (currframe < frames.size() - 1) currframe++;
+            if (currframe < framesource->size() - 1) currframe++;
+            playdirection = 1;
             nextframe = true;
         }
         break;
     case 49: // 1 - stage single
         if (paused)
-            staged[currframe] = unstaged[currframe];
+            stageBox(currobject, currframe, unstaged[currframe]);
         break;
     case 97: // A - stage all unstaged
         if (paused)
         {
-            for (int i = 0; i < staged.size(); i++)
-            {
-                staged[i] = unstaged[i];
-            }
+            stageBoxes(currobject, 0, (int)staged.size() - 1, unstaged);
         }
         break;
     case 99: // C - toggle continuos stage
@@ -273,37 +539,34 @@ bool keyboardControl(int key)
         if (paused)
         {
             unstaged[currframe] = staged[currframe];
-            tracker->Init(frame, staged[currframe], regressor.get());
+            if (selected) trackerworker->reset(currobject, currframe, staged[currframe]);
         }
         break;
     case 114: // R - set all unstaged to stage (reset)
         if (paused)
         {
-            for (int i = 0; i < staged.size(); i++)
-            {
-                unstaged[i] = staged[i];
-            }
-            tracker->Init(frame, staged[currframe], regressor.get());
+            unstaged = staged;
+            if (selected) trackerworker->reset(currobject, currframe, staged[currframe]);
         }
         break;
     case 115: // S - save the annotations
         saveVideo();
         break;
     case 40: // ( - set frame as the beginning
-        if (currframe != lastframe) firstframe = currframe;
+        if (currframe != lastframe) setRange(currframe, lastframe);
         break;
     case 41: // ) - set frame as the ending
-        if (currframe != firstframe) lastframe = currframe;
+        if (currframe != firstframe) setRange(firstframe, currframe);
         break;
     case 43: // + - speed up two times (up to 1x speed)
         if (waitkeyduration > 1) waitkeyduration /= 2;
         printf("Time for frame:  %dms\n", waitkeyduration);
         break;
     case 105: // I - initialize with current unstaged
-        tracker->Init(frame, unstaged[currframe], regressor.get());
+        if (selected) trackerworker->reset(currobject, currframe, unstaged[currframe]);
         break;
     case 111: // O - initialize with current staged
-        tracker->Init(frame, staged[currframe], regressor.get());
+        if (selected) trackerworker->reset(currobject, currframe, staged[currframe]);
         break;
     case 45: // - - slow down two times
         waitkeyduration *= 2;
@@ -311,14 +574,37 @@ bool keyboardControl(int key)
         break;
     case 113: // Q - toggle tracker usage
         toggletracking = !toggletracking;
+        trackerworker->setEnabled(toggletracking);
         printf("Tracking turned %s\n", toggletracking ? "on" : "off");
         break;
+    case 116: // T - track the segments between staged keyframes in parallel
+        if (paused) trackKeyframeSegments();
+        break;
+    case 103: // G - fill the gaps between staged keyframes by tracking
+        if (paused) fillStagedGaps();
+        break;
+    case 110: // N - add an object
+        currobject = addObject();
+        printf("Annotating object %d of %d\n", currobject + 1, (int)objects.size());
+        break;
+    case 91: // [ - select the previous object
+        currobject = (currobject + objects.size() - 1) % objects.size();
+        printf("Annotating object %d of %d\n", currobject + 1, (int)objects.size());
+        break;
+    case 93: // ] - select the next object
+        currobject = (currobject + 1) % objects.size();
+        printf("Annotating object %d of %d\n", currobject + 1, (int)objects.size());
+        break;
     case 38: // & - move to first frame
         currframe = firstframe;
         break;
     case 42: // * - move to last frame
         currframe = lastframe;
         break;
+    case 102: // F - show frame cache and tracker statistics
+        framesource->printStatistics();
+        trackerbackend->printLatency();
+        break;
     case 104: // H - show help
         printf("\n=============================================================\n");
         printf("H     - help\n");
@@ -339,13 +625,691 @@ bool keyboardControl(int key)
         printf("I     - initialize tracker with current unstaged bounding box\n");
         printf("O     - initialize tracker with current staged bounding box\n");
         printf("Q     - toggle tracker usage\n");
+        printf("T     - track from all staged keyframes in parallel\n");
+        printf("G     - fill the gaps between staged keyframes by tracking\n");
+        printf("N     - add an object\n");
+        printf("[ ]   - select the previous or the next object\n");
         printf("&     - go to the first frame\n");
         printf("*     - go to the last frame\n");
+        printf("F     - show frame cache and tracker statistics\n");
         printf("=============================================================\n");
     }
     return true;
 }
 
+std::unique_ptr<FrameSink> createFrameSink(const std::string &layout, const std::string &directory)
+{
+    if (layout == "jpeg")
+    {
+        return std::unique_ptr<FrameSink>(new JpegDirectorySink(directory));
+    }
+    if (layout == "pack")
+    {
+        std::unique_ptr<FramePackWriter> pack(new FramePackWriter());
+        if (pack->open(directory) != 0) return nullptr;
+        return std::move(pack);
+    }
+    printf("Unknown frames layout:  %s\n", layout.c_str());
+    return nullptr;
+}
+
+int convertFrames(const std::string &layout)
+{
+    if (outputdir == "" || outputdir == framesdir)
+    {
+        printf("--output-directory must be set and differ from the frames directory\n");
+        return 1;
+    }
+    std::unique_ptr<FrameSource> source = openFrameSource(framesdir);
+    if (!source)
+    {
+        printf("%s directory does not exist, is empty or you have not right permissions\n", framesdir.c_str());
+        return 1;
+    }
+    std::unique_ptr<FrameSink> sink = createFrameSink(layout, outputdir);
+    if (!sink) return 1;
+    printf("Converting %d frames from %s to %s\n", source->size(), framesdir.c_str(), outputdir.c_str());
+    if (copyFrames(*source, *sink) != 0)
+    {
+        printf("Error converting frames\n");
+        return 1;
+    }
+    printf("Converted frames saved to %s\n", outputdir.c_str());
+    return 0;
+}
+
+int runHeadless(const std::vector<float> &initbox)
+{
+    if (firstframe < 0 || lastframe >= framesource->size() || firstframe >= lastframe)
+    {
+        printf("Invalid frame range %d-%d\n", firstframe, lastframe);
+        return 1;
+    }
+
+    // the init box starts the first object, the others start from their annotations
+    std::vector<BoundingBox> bboxes(objects.size());
+    for (size_t object = 0; object < objects.size(); object++)
+    {
+        if (object == 0 && initbox.size() == 4)
+        {
+            bboxes[object].x1_ = initbox[0];
+            bboxes[object].y1_ = initbox[1];
+            bboxes[object].x2_ = initbox[2];
+            bboxes[object].y2_ = initbox[3];
+        }
+        else if ((object > 0 || initbox.empty()) && objects[object].index.staged(firstframe))
+        {
+            bboxes[object] = objects[object].staged[firstframe];
+        }
+        else
+        {
+            printf("Headless mode requires --init-box x1,y1,x2,y2 or --input-annotations with a box in the first frame\n");
+            return 1;
+        }
+    }
+    printf("Tracking %d objects in frames %d-%d\n", (int)objects.size(), firstframe, lastframe);
+    LatencyStats decodestats;
+    LatencyStats preparestats;
+    // the objects are tracked together, in one step of the backend per frame
+    std::vector<std::unique_ptr<ObjectTracker>> headlesstrackers;
+    std::vector<ObjectTracker *> trackers;
+    for (size_t object = 0; object < objects.size(); object++)
+    {
+        headlesstrackers.push_back(trackerbackend->createTracker());
+        trackers.push_back(headlesstrackers.back().get());
+    }
+    ScopedTimer total;
+
+    for (int i = firstframe; i <= lastframe; i++)
+    {
+        // the frame is decoded at the largest scale none of the trackers loses detail at
+        int scale = maxdecodescale;
+        for (size_t object = 0; object < objects.size(); object++)
+        {
+            int objectscale = i == firstframe ? trackerbackend->reducedScale(bboxes[object], maxdecodescale) : trackers[object]->reducedScale(maxdecodescale);
+            scale = std::min(scale, objectscale);
+        }
+        // decode the following full frames in the background while tracking, the reduced ones are cheap enough on demand
+        if (scale == 1) framesource->prefetch(i, 1);
+        ScopedTimer decodetimer;
+        cv::Mat image = framesource->readReduced(i, scale);
+        double decodetime = decodetimer.stop();
+        decodestats.add(decodetime);
+        if (!image.data)
+        {
+            printf("Frame not valid:  %s\n", framesource->name(i).c_str());
+            return 1;
+        }
+        if (i == firstframe)
+        {
+            for (size_t object = 0; object < objects.size(); object++) trackers[object]->init(image, bboxes[object], scale);
+        }
+        else
+        {
+            double regressiontime = timedregressor ? timedregressor->latency().total() : 0.0;
+            double tracktime = trackerbackend->latency().total();
+            trackerbackend->track(trackers, image, bboxes, scale);
+            tracktime = trackerbackend->latency().total() - tracktime;
+            // everything but the network is the cost of preparing its input
+            if (timedregressor) preparestats.add(decodetime + tracktime - (timedregressor->latency().total() - regressiontime));
+        }
+        for (size_t object = 0; object < objects.size(); object++)
+        {
+            objects[object].unstaged[i] = bboxes[object];
+            stageBox(object, i, bboxes[object]);
+        }
+    }
+    double trackingtime = total.stop() / 1000.0;
+
+    ScopedTimer savetimer;
+    int status = saveVideo();
+    double savetime = savetimer.stop() / 1000.0;
+
+    int tracked = lastframe - firstframe;
+    printf("Tracked %d frames in %.2fs (%.2f frames/s)\n", tracked, trackingtime, trackingtime > 0 ? tracked / trackingtime : 0.0);
+    decodestats.print("Frame decoding");
+    trackerbackend->printLatency();
+    if (timedregressor)
+    {
+        preparestats.print("Decoding and cropping per tracked frame");
+        timedregressor->latency().print("Regressor (" + regressorname + ")");
+    }
+    printf("Saving:  %.2fs\n", savetime);
+    return status;
+}
+
+/**
+ * Creates the regressor of the inference backend (caffe, dnn or native)
+ * running the network from the prototxt with the weights from the caffemodel.
+ *
+ * Returns null if the backend is not available or the network cannot be loaded.
+ */
+std::unique_ptr<BoxRegressor> createRegressor(const std::string &backend, const std::string &definition, const std::string &weights)
+{
+    if (backend != "caffe" && device == InferenceDevice::GPU)
+    {
+        printf("The %s backend runs on the CPU\n", backend.c_str());
+    }
+    if (backend == "native")
+    {
+        if (cputhreads > 0) cv::setNumThreads(cputhreads);
+        std::shared_ptr<const NativeWeights> native;
+        if (int8calibration != "")
+        {
+            Int8Calibration calibration;
+            if (calibration.load(int8calibration) != 0) return nullptr;
+            native = NativeWeights::load(weights, &calibration);
+        }
+        else
+        {
+            native = NativeWeights::load(weights);
+        }
+        if (!native) return nullptr;
+        regressorname = std::string("native ") + native->kernels->name + (native->quantized ? " int8" : "");
+        return std::unique_ptr<BoxRegressor>(new NativeRegressor(native));
+    }
+#ifdef HAVE_OPENCV_DNN
+    if (backend == "dnn")
+    {
+        if (cputhreads > 0) cv::setNumThreads(cputhreads);
+        std::unique_ptr<DnnRegressor> dnn(new DnnRegressor());
+        if (dnn->load(definition, weights) != 0) return nullptr;
+        regressorname = "OpenCV DNN CPU";
+        return std::unique_ptr<BoxRegressor>(std::move(dnn));
+    }
+#endif
+#ifdef USE_CAFFE
+    if (backend == "caffe")
+    {
+        if (device == InferenceDevice::CPU && cputhreads > 0) setBlasThreads(cputhreads);
+        setupInferenceDevice(device, 0);
+        printf("Set %s Caffe mode\n", inferenceDeviceName(device));
+        std::unique_ptr<CaffeRegressor> caffe(new CaffeRegressor());
+        if (caffe->load(definition, weights, fullgraph) != 0) return nullptr;
+        // Regressor switches Caffe to its default mode while loading the network
+        setupInferenceDevice(device, 0);
+        regressorname = std::string("Caffe ") + inferenceDeviceName(device);
+        return std::unique_ptr<BoxRegressor>(std::move(caffe));
+    }
+#endif
+    std::string names;
+    for (const std::string &name : availableBackends()) names += " " + name;
+    printf("Inference backend %s is not available, the available backends are:%s\n", backend.c_str(), names.c_str());
+    return nullptr;
+}
+
+/**
+ * Creates the tracker backend selected with --tracker, GOTURN runs on the
+ * regressor. Returns null if the tracker is unknown.
+ */
+std::unique_ptr<TrackerBackend> createTrackerBackend(BoxRegressor *regressor)
+{
+    if (trackername == "goturn") return std::unique_ptr<TrackerBackend>(new GoturnBackend(*regressor));
+    if (trackername == "flow") return std::unique_ptr<TrackerBackend>(new FlowBackend());
+    printf("Unknown tracker %s, the available trackers are:  goturn flow\n", trackername.c_str());
+    return nullptr;
+}
+
+/**
+ * Returns count tracker backends for the parallel tracking workers, or an
+ * empty vector if they cannot be created. With GOTURN, the native workers
+ * share the weights of the regressor, the other inference backends load
+ * the network once per worker.
+ */
+std::vector<TrackerBackend *> trackingWorkers(size_t count)
+{
+    NativeRegressor *native = dynamic_cast<NativeRegressor *>(regressor.get());
+    while (segmentbackends.size() < count)
+    {
+        std::unique_ptr<BoxRegressor> created;
+        if (trackername == "goturn")
+        {
+            if (native) created.reset(new NativeRegressor(native->sharedWeights()));
+            else created = createRegressor(backendname, prototxt, caffemodel);
+            if (!created) return std::vector<TrackerBackend *>();
+        }
+        segmentbackends.push_back(createTrackerBackend(created.get()));
+        segmentregressors.push_back(std::move(created));
+    }
+    std::vector<TrackerBackend *> workers;
+    for (size_t i = 0; i < count; i++) workers.push_back(segmentbackends[i].get());
+    return workers;
+}
+
+/// Sets up the inference device in the tracking worker threads
+void setupTrackingWorker()
+{
+    setupInferenceDevice(device, 0);
+}
+
+/**
+ * Tracks the current object from each staged keyframe in first-frame to
+ * last-frame up to the next one, with the segments running in parallel on
+ * segment-threads workers. The tracked boxes replace the unstaged boxes of
+ * the segments. Returns 0 on success.
+ */
+int trackKeyframeSegments()
+{
+    std::vector<TrackingSegment> segments = splitAtKeyframes(objects[currobject].staged, firstframe, lastframe);
+    if (segments.empty())
+    {
+        printf("No staged keyframes in frames %d-%d\n", firstframe, lastframe);
+        return 1;
+    }
+    std::vector<TrackerBackend *> workers = trackingWorkers(std::max(1, std::min((int)segments.size(), segmentthreads)));
+    if (workers.empty()) return 1;
+
+    ScopedTimer timer;
+    int status = trackSegments(*framesource, segments, workers, maxdecodescale, setupTrackingWorker, objects[currobject].unstaged);
+    if (status != 0) return status;
+    printf("Tracked %d segments of frames %d-%d on %d threads in %.2fs\n", (int)segments.size(),
+        segments.front().first, lastframe, (int)workers.size(), timer.stop() / 1000.0);
+    return 0;
+}
+
+/**
+ * Fills the gaps of the object with the fusion of the forward and backward
+ * tracks between the keyframes, on segment-threads workers. The keyframes
+ * are read from staged, the filled boxes are written to boxes. Returns 0
+ * on success.
+ */
+int fillGapsByTracking(const std::vector<BoundingBox> &staged, const std::vector<TrackingGap> &gaps, std::vector<BoundingBox> &boxes)
+{
+    if (gaps.empty()) return 0;
+    // a gap has two tracks
+    std::vector<TrackerBackend *> workers = trackingWorkers(std::max(1, std::min(2 * (int)gaps.size(), segmentthreads)));
+    if (workers.empty()) return 1;
+    ScopedTimer timer;
+    if (fillGaps(*framesource, staged, gaps, workers, maxdecodescale, setupTrackingWorker, boxes) != 0) return 1;
+    printf("Filled %d gaps on %d threads in %.2fs\n", (int)gaps.size(), (int)workers.size(), timer.stop() / 1000.0);
+    return 0;
+}
+
+/**
+ * Fills the gaps between the staged keyframes of the current object in
+ * first-frame to last-frame by tracking, as unstaged boxes. Returns 0 on
+ * success.
+ */
+int fillStagedGaps()
+{
+    ObjectTrack &object = objects[currobject];
+    std::vector<TrackingGap> gaps = findGaps(object.staged, firstframe, lastframe);
+    if (gaps.empty())
+    {
+        printf("No gaps between staged keyframes in frames %d-%d\n", firstframe, lastframe);
+        return 1;
+    }
+    return fillGapsByTracking(object.staged, gaps, object.unstaged);
+}
+
+/// Returns the largest difference of the coordinates of the boxes
+double boxDifference(const BoundingBox &a, const BoundingBox &b)
+{
+    return std::max(std::max(std::abs(a.x1_ - b.x1_), std::abs(a.y1_ - b.y1_)),
+        std::max(std::abs(a.x2_ - b.x2_), std::abs(a.y2_ - b.y2_)));
+}
+
+/// Crops of a tracker step around the staged box of the previous frame
+struct StagedStep
+{
+    cv::Mat previous;
+    BoundingBox prior;
+    cv::Mat current;
+    cv::Mat target;
+    cv::Mat search;
+    BoundingBox searchlocation;
+    double edgex;
+    double edgey;
+};
+
+/**
+ * Calls the function with the tracker steps from the staged boxes of all
+ * objects in first-frame to last-frame, cropped like in the tracker.
+ * Returns the number of steps, or -1 if a frame cannot be read.
+ */
+int forEachStagedStep(const std::function<void(const StagedStep &)> &function)
+{
+    int steps = 0;
+    for (const ObjectTrack &object : objects)
+    {
+        for (int i = firstframe + 1; i <= lastframe; i++)
+        {
+            if (!object.index.staged(i - 1)) continue;
+            BoundingBox prior = object.staged[i - 1];
+            StagedStep step;
+            step.previous = framesource->read(i - 1);
+            step.prior = prior;
+            step.current = framesource->read(i);
+            if (!step.previous.data || !step.current.data)
+            {
+                printf("Frame not valid:  %s\n", framesource->name(i).c_str());
+                return -1;
+            }
+            CropPadImage(prior, step.previous, &step.target);
+            CropPadImage(prior, step.current, &step.search, &step.searchlocation, &step.edgex, &step.edgey);
+            function(step);
+            steps++;
+        }
+    }
+    return steps;
+}
+
+/**
+ * Runs the regressors on the staged boxes and compares them with the first.
+ *
+ * All regressors get the same target and search crops, taken around the
+ * staged boxes of consecutive frames like in the tracker. The differences
+ * of the network outputs and of the resulting boxes (in pixels) from the
+ * first regressor are printed, along with the latencies of all of them.
+ * Returns 0 if the outputs agree within the tolerance.
+ */
+int compareRegressors(std::vector<std::unique_ptr<BoxRegressor>> &regressors, const std::vector<std::string> &names, double tolerance)
+{
+    const int count = regressors.size();
+    std::vector<LatencyStats> latencies(count);
+    std::vector<double> maxoutputdiff(count, 0.0);
+    std::vector<double> sumoutputdiff(count, 0.0);
+    std::vector<double> maxpixeldiff(count, 0.0);
+
+    int compared = forEachStagedStep([&](const StagedStep &step)
+    {
+        std::vector<BoundingBox> estimates(count);
+        std::vector<BoundingBox> boxes(count);
+        for (int r = 0; r < count; r++)
+        {
+            ScopedTimer timer;
+            regressors[r]->regress(step.target, step.search, estimates[r]);
+            latencies[r].add(timer.stop());
+
+            BoundingBox unscaled;
+            estimates[r].Unscale(step.search, &unscaled);
+            unscaled.Uncenter(step.current, step.searchlocation, step.edgex, step.edgey, &boxes[r]);
+        }
+        for (int r = 1; r < count; r++)
+        {
+            double outputdiff = boxDifference(estimates[0], estimates[r]);
+            maxoutputdiff[r] = std::max(maxoutputdiff[r], outputdiff);
+            sumoutputdiff[r] += outputdiff;
+            maxpixeldiff[r] = std::max(maxpixeldiff[r], boxDifference(boxes[0], boxes[r]));
+        }
+    });
+    if (compared < 0) return 1;
+    if (compared == 0)
+    {
+        printf("No staged boxes to compare in frames %d-%d, provide --input-annotations\n", firstframe, lastframe);
+        return 1;
+    }
+
+    printf("Compared %d frames with %s\n", compared, names[0].c_str());
+    latencies[0].print(names[0]);
+    int status = 0;
+    for (int r = 1; r < count; r++)
+    {
+        printf("%s:  max output difference %g (mean %g), max box difference %.3fpx\n",
+            names[r].c_str(), maxoutputdiff[r], sumoutputdiff[r] / compared, maxpixeldiff[r]);
+        latencies[r].print(names[r]);
+        if (maxoutputdiff[r] > tolerance)
+        {
+            printf("The %s output differs from %s by more than %g\n", names[r].c_str(), names[0].c_str(), tolerance);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/**
+ * Tracks the first object with each regressor from its first staged box
+ * in first-frame to last-frame, without corrections.
+ *
+ * Prints the tracking speed of each regressor, the mean IoU of its track
+ * with the staged boxes, and the mean and the final IoU with the track of
+ * the first regressor, which shows how far the differences of the
+ * regressors accumulate. Returns 0 on success.
+ */
+int compareTracks(std::vector<std::unique_ptr<BoxRegressor>> &regressors, const std::vector<std::string> &names)
+{
+    const std::vector<BoundingBox> &staged = objects[0].staged;
+    const StagedFrames &index = objects[0].index;
+    int start = firstframe;
+    while (start < lastframe && !index.staged(start)) start++;
+    if (start >= lastframe)
+    {
+        printf("No staged box to start tracking from in frames %d-%d\n", firstframe, lastframe);
+        return 1;
+    }
+
+    const int count = regressors.size();
+    std::vector<std::vector<BoundingBox>> tracks(count);
+    std::vector<double> elapsed(count, 0.0);
+    for (int r = 0; r < count; r++)
+    {
+        GoturnTracker tracker;
+        BoundingBox bbox = staged[start];
+        cv::Mat first = framesource->read(start);
+        if (!first.data)
+        {
+            printf("Frame not valid:  %s\n", framesource->name(start).c_str());
+            return 1;
+        }
+        tracker.init(first, bbox);
+        for (int i = start + 1; i <= lastframe; i++)
+        {
+            cv::Mat image = framesource->read(i);
+            if (!image.data)
+            {
+                printf("Frame not valid:  %s\n", framesource->name(i).c_str());
+                return 1;
+            }
+            ScopedTimer timer;
+            tracker.track(image, *regressors[r], bbox);
+            elapsed[r] += timer.stop();
+            tracks[r].push_back(bbox);
+        }
+    }
+
+    printf("Tracked frames %d-%d from the staged box\n", start, lastframe);
+    for (int r = 0; r < count; r++)
+    {
+        double annotatedoverlap = 0.0;
+        int annotated = 0;
+        double trackoverlap = 0.0;
+        for (size_t step = 0; step < tracks[r].size(); step++)
+        {
+            if (index.staged(start + 1 + step))
+            {
+                annotatedoverlap += boxOverlap(tracks[r][step], staged[start + 1 + step]);
+                annotated++;
+            }
+            trackoverlap += boxOverlap(tracks[r][step], tracks[0][step]);
+        }
+        printf("%s:  %.1f frames/s", names[r].c_str(), tracks[r].size() * 1000.0 / elapsed[r]);
+        if (annotated > 0) printf(", mean IoU with the staged boxes %.3f", annotatedoverlap / annotated);
+        if (r > 0)
+        {
+            printf(", IoU with the %s track mean %.3f, final %.3f", names[0].c_str(),
+                trackoverlap / tracks[r].size(), boxOverlap(tracks[r].back(), tracks[0].back()));
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+/**
+ * Measures the preparation of the network inputs on the staged steps -
+ * GOTURN's chain (CropPadImage, then resize, float conversion, split and
+ * mean subtraction) against the fused cropNetworkInput() kernel, for both
+ * the target and the search region. Prints the latencies and the largest
+ * difference of the inputs. Returns 0 on success.
+ */
+int benchmarkCrops()
+{
+    std::vector<float> chaintarget(NETWORK_INPUT_VALUES), chainsearch(NETWORK_INPUT_VALUES);
+    std::vector<float> fusedtarget(NETWORK_INPUT_VALUES), fusedsearch(NETWORK_INPUT_VALUES);
+    LatencyStats chainstats, fusedstats;
+    double maxdifference = 0.0;
+    int steps = forEachStagedStep([&](const StagedStep &step)
+    {
+        ScopedTimer chaintimer;
+        cv::Mat target, search;
+        BoundingBox location;
+        double edgex, edgey;
+        CropPadImage(step.prior, step.previous, &target);
+        CropPadImage(step.prior, step.current, &search, &location, &edgex, &edgey);
+        preprocessCrop(target, chaintarget.data());
+        preprocessCrop(search, chainsearch.data());
+        chainstats.add(chaintimer.stop());
+
+        ScopedTimer fusedtimer;
+        CropPlacement targetplacement, searchplacement;
+        cropNetworkInput(step.previous, step.prior, fusedtarget.data(), targetplacement);
+        cropNetworkInput(step.current, step.prior, fusedsearch.data(), searchplacement);
+        fusedstats.add(fusedtimer.stop());
+
+        for (int i = 0; i < NETWORK_INPUT_VALUES; i++)
+        {
+            maxdifference = std::max(maxdifference, (double)std::fabs(chaintarget[i] - fusedtarget[i]));
+            maxdifference = std::max(maxdifference, (double)std::fabs(chainsearch[i] - fusedsearch[i]));
+        }
+    });
+    if (steps < 0) return 1;
+    if (steps == 0)
+    {
+        printf("No staged boxes to benchmark in frames %d-%d, provide --input-annotations\n", firstframe, lastframe);
+        return 1;
+    }
+
+    printf("Prepared the inputs of %d steps (%s kernels)\n", steps, selectNativeKernels().name);
+    chainstats.print("CropPadImage and preprocessing");
+    fusedstats.print("Fused crop kernel");
+    printf("Speedup %.2fx, max input difference %g\n", chainstats.mean() / fusedstats.mean(), maxdifference);
+    return 0;
+}
+
+/**
+ * Compares the inference backends available in the build with the first
+ * one (Caffe, if available). Returns 0 if they all give the same outputs.
+ */
+int compareBackends()
+{
+    // network outputs are in the search region scaled to 0-10
+    const double tolerance = 0.01;
+
+    std::vector<std::string> backends = availableBackends();
+    if (backends.size() < 2)
+    {
+        printf("Only the %s backend is available, there is nothing to compare\n", backends[0].c_str());
+        return 1;
+    }
+    std::vector<std::unique_ptr<BoxRegressor>> regressors;
+    std::vector<std::string> names;
+    for (const std::string &backend : backends)
+    {
+        regressors.push_back(createRegressor(backend, prototxt, caffemodel));
+        if (!regressors.back()) return 1;
+        names.push_back(regressorname);
+    }
+    int status = compareRegressors(regressors, names, tolerance);
+    // need to release regressor before CUDA context is out of scope
+    if (backends[0] == "caffe") regressors[0].release();
+    if (status == 0) printf("All backends match %s\n", names[0].c_str());
+    return status;
+}
+
+/**
+ * Compares the network with its compressed version from PREFIX.prototxt
+ * and PREFIX.caffemodel, both run by the selected backend.
+ *
+ * Prints the load times of both models, and the output differences and
+ * the latencies of the compressed one. Returns 0 on success.
+ */
+int compareModels(const std::string &prefix)
+{
+    const std::string models[2][2] = {
+        { prototxt, caffemodel },
+        { prefix + ".prototxt", prefix + ".caffemodel" }
+    };
+    std::vector<std::unique_ptr<BoxRegressor>> regressors;
+    std::vector<std::string> names;
+    for (const std::string (&model)[2] : models)
+    {
+        ScopedTimer timer;
+        regressors.push_back(createRegressor(backendname, model[0], model[1]));
+        if (!regressors.back()) return 1;
+        printf("Loaded %s in %.0f ms\n", model[1].c_str(), timer.stop());
+        names.push_back(regressorname + " " + model[1]);
+    }
+    // the compressed network is expected to differ, the differences are only reported
+    int status = compareRegressors(regressors, names, std::numeric_limits<double>::infinity());
+    // need to release regressors before CUDA context is out of scope
+    if (backendname == "caffe")
+    {
+        for (std::unique_ptr<BoxRegressor> &compared : regressors) compared.release();
+    }
+    return status;
+}
+
+/**
+ * Records the activation ranges of the native network on the tracker steps
+ * from the staged boxes. The ranges already in the calibration file are
+ * kept, so the calibration can be run over several sequences. Returns 0 on
+ * success.
+ */
+int calibrateInt8(const std::string &filename)
+{
+    Int8Calibration calibration;
+    if (fileAccessible(filename) && calibration.load(filename) != 0) return 1;
+    if (cputhreads > 0) cv::setNumThreads(cputhreads);
+    std::shared_ptr<const NativeWeights> weights = NativeWeights::load(caffemodel);
+    if (!weights) return 1;
+    NativeRegressor calibrated(weights);
+    calibrated.setCalibration(&calibration);
+
+    int steps = forEachStagedStep([&](const StagedStep &step)
+    {
+        BoundingBox estimate;
+        calibrated.regress(step.target, step.search, estimate);
+    });
+    if (steps < 0) return 1;
+    if (steps == 0)
+    {
+        printf("No staged boxes to calibrate on in frames %d-%d, provide --input-annotations\n", firstframe, lastframe);
+        return 1;
+    }
+    if (calibration.save(filename) != 0) return 1;
+    printf("Calibrated the int8 activation ranges on %d frames, saved to %s\n", steps, filename.c_str());
+    return 0;
+}
+
+/**
+ * Compares the native backend in fp32 and in int8 with the calibration from
+ * --int8-calibration, on single tracker steps and on whole tracks.
+ */
+int compareInt8()
+{
+    if (int8calibration == "")
+    {
+        printf("--compare-int8 requires --int8-calibration\n");
+        return 1;
+    }
+    Int8Calibration calibration;
+    if (calibration.load(int8calibration) != 0) return 1;
+    if (cputhreads > 0) cv::setNumThreads(cputhreads);
+    std::shared_ptr<const NativeWeights> fp32 = NativeWeights::load(caffemodel);
+    std::shared_ptr<const NativeWeights> int8 = NativeWeights::load(caffemodel, &calibration);
+    if (!fp32 || !int8) return 1;
+
+    std::vector<std::unique_ptr<BoxRegressor>> regressors;
+    regressors.push_back(std::unique_ptr<BoxRegressor>(new NativeRegressor(fp32)));
+    regressors.push_back(std::unique_ptr<BoxRegressor>(new NativeRegressor(int8)));
+    std::vector<std::string> names = {
+        std::string("native ") + fp32->kernels->name + " fp32",
+        std::string("native ") + int8->kernels->name + " int8"
+    };
+    // int8 is expected to differ, the differences are only reported
+    if (compareRegressors(regressors, names, std::numeric_limits<double>::infinity()) != 0) return 1;
+    return compareTracks(regressors, names);
+}
+
 bool tryLoading(const char *datadir)
 {
     return true;
@@ -355,7 +1319,22 @@ int main(int argc, char *argv[])
 {
     cxxopts::Options options("Dataset creator tool", "Tool for creating bounding boxes for objects in video frames for the tracking tasks, classification tasks (within bounding boxes) and detection tasks (single object per image)");
 
-    std::string inputannotations;
+    std::vector<std::string> inputannotations;
+    std::string convertframes;
+    std::string convertannotations;
+    std::string indexroot;
+    std::string indexfile;
+    int indexthreads = std::thread::hardware_concurrency();
+    std::vector<float> initbox;
+    bool comparebackends = false;
+    bool profilegraph = false;
+    std::string compressmodel;
+    int fc6rank = 512;
+    int fc7rank = 0;
+    std::string comparemodel;
+    std::string calibrateint8;
+    bool compareint8 = false;
+    bool benchmarkcrops = false;
 
     options.add_options()
         ("input-video", "Input video to extract labels from", cxxopts::value(videoname))
@@ -363,9 +1342,47 @@ int main(int argc, char *argv[])
         ("output-directory", "The directory containing labeled frames and annotations", cxxopts::value(outputdir))
         ("first-frame", "The id of the first frame (0-based)", cxxopts::value(firstframe))
         ("last-frame", "The id of the last frame (0-based)", cxxopts::value(lastframe))
-        ("input-annotations", "Input .ann file containing the annotations from frames from first-frame to last-frame", cxxopts::value(inputannotations))
+        ("input-annotations", "Input .ann or binary annotations files containing the annotations from frames from first-frame to last-frame, one per object", cxxopts::value(inputannotations))
         ("prototxt-path", "Path to the .prototxt file", cxxopts::value(prototxt))
         ("caffemodel-path", "Path to the .caffemodel file", cxxopts::value(caffemodel))
+        ("extraction-threads", "Number of threads used for extracting frames from the input video", cxxopts::value(extractionthreads))
+        ("frame-store", "Layout of the frames extracted from the input video: jpeg (one file per frame) or pack (single frame pack)", cxxopts::value(framestore))
+        ("direct-video", "Annotate the input video directly, without extracting the frames to FRAMES_DIRECTORY", cxxopts::value(directvideo))
+        ("seek-segment", "Number of consecutive frames decoded together in the direct video mode", cxxopts::value(seeksegment))
+        ("export-width", "Width of the frames saved with S, re-encodes them (0 keeps the width, or scales it with export-height)", cxxopts::value(exportoptions.width))
+        ("export-height", "Height of the frames saved with S, re-encodes them (0 keeps the height, or scales it with export-width)", cxxopts::value(exportoptions.height))
+        ("export-quality", "JPEG quality (1-100) of the frames saved with S, re-encodes them (0 copies the encoded frames as they are)", cxxopts::value(exportoptions.quality))
+        ("export-threads", "Number of threads used for saving the frames with S", cxxopts::value(exportthreads))
+        ("journal", "Path of the journal of the staged boxes, restored on startup (by default OUTPUT_DIRECTORY/annotations.journal)", cxxopts::value(journalpath))
+        ("frame-cache-mb", "Memory limit for the decoded frames cache, in megabytes", cxxopts::value(framecachemb))
+        ("read-ahead", "Number of frames decoded in advance in the playing direction", cxxopts::value(readahead))
+        ("device", "Device running the tracker network: cpu or gpu", cxxopts::value(devicename))
+        ("cpu-threads", "Number of threads used by the BLAS library in the cpu mode, or by the native backend (0 - library default)", cxxopts::value(cputhreads))
+        ("inference-backend", "Implementation of the tracker network: caffe, dnn (OpenCV DNN module) or native (built-in CPU implementation)", cxxopts::value(backendname))
+        ("full-graph", "Run the network from the prototxt as is, including the layers used only in training", cxxopts::value(fullgraph))
+        ("profile-graph", "Compare the latency and memory of the full and the inference-only Caffe network and quit", cxxopts::value(profilegraph))
+        ("compare-backends", "Compare the outputs and latencies of the available backends on the staged boxes from input-annotations and quit", cxxopts::value(comparebackends))
+        ("compress-model", "Write the low-rank version of the network to PREFIX.prototxt and PREFIX.caffemodel and quit", cxxopts::value(compressmodel))
+        ("fc6-rank", "Rank of the fc6 weights in the compressed network", cxxopts::value(fc6rank))
+        ("fc7-rank", "Rank of the fc7 weights in the compressed network (0 - not compressed)", cxxopts::value(fc7rank))
+        ("compare-model", "Compare the network with the compressed one from PREFIX.prototxt and PREFIX.caffemodel on the staged boxes from input-annotations and quit", cxxopts::value(comparemodel))
+        ("int8-calibration", "Run the native backend in int8, with the activation ranges from the calibration file", cxxopts::value(int8calibration))
+        ("calibrate-int8", "Record the int8 activation ranges on the staged boxes from input-annotations, add them to the calibration file and quit", cxxopts::value(calibrateint8))
+        ("compare-int8", "Compare the native backend in fp32 and int8 on the staged boxes from input-annotations, including the tracking drift, and quit", cxxopts::value(compareint8))
+        ("benchmark-crops", "Compare the speed of the fused crop kernel with CropPadImage and preprocessing on the staged boxes from input-annotations and quit", cxxopts::value(benchmarkcrops))
+        ("headless", "Track the object from first-frame to last-frame without GUI and save the annotations", cxxopts::value(headless))
+        ("init-box", "Initial bounding box x1,y1,x2,y2 for the headless mode (by default the first box from input-annotations is used)", cxxopts::value(initbox))
+        ("tracker", "Tracker proposing the boxes:  goturn (the network) or flow (optical flow, much cheaper, for static cameras and slow objects)", cxxopts::value(trackername))
+        ("track-ahead", "Number of frames the tracker runs ahead of the displayed frame", cxxopts::value(trackahead))
+        ("checkpoint-mb", "Memory limit of the tracker state checkpoints in MB", cxxopts::value(checkpointmb))
+        ("max-decode-scale", "Largest downscale (1, 2, 4 or 8) of the frames decoded for tracking, 1 decodes them at full resolution", cxxopts::value(maxdecodescale))
+        ("segment-threads", "Number of tracks between staged keyframes run in parallel (T and G keys, tracker gap filling)", cxxopts::value(segmentthreads))
+        ("fill-gaps", "Filling of the frames missing in input-annotations in the GUI:  linear (interpolation) or tracker (fused forward and backward tracks)", cxxopts::value(gapfilling))
+        ("convert-frames", "Convert frames from FRAMES_DIRECTORY to OUTPUT_DIRECTORY using the given layout (jpeg or pack) and quit", cxxopts::value(convertframes))
+        ("convert-annotations", "Convert input-annotations files to OUTPUT_DIRECTORY using the given format (text or binary) and quit", cxxopts::value(convertannotations))
+        ("index-dataset", "Index the sequence directories of the given dataset root, print the dataset statistics and quit", cxxopts::value(indexroot))
+        ("index-file", "Index file updated by index-dataset (by default ROOT/dataset.index)", cxxopts::value(indexfile))
+        ("index-threads", "Number of threads scanning the sequences in index-dataset", cxxopts::value(indexthreads))
         ("h,help", "Prints help for the application")
     ;
 
@@ -379,158 +1396,242 @@ int main(int argc, char *argv[])
         printf("%s\n", options.help().c_str());
     }
 
-    if (framesdir == "")
+    if (compressmodel != "")
+    {
+        std::vector<LowRankLayer> layers;
+        if (fc6rank > 0) layers.push_back({ "fc6-new", fc6rank });
+        if (fc7rank > 0) layers.push_back({ "fc7-new", fc7rank });
+        return compressModel(prototxt, caffemodel, layers, compressmodel);
+    }
+
+    if (framesdir != "" && framesdir[framesdir.size() - 1] != '/') framesdir += "/";
+    if (outputdir != "" && outputdir[outputdir.size() - 1] != '/') outputdir += "/";
+
+    if (convertannotations != "")
+    {
+        return convertAnnotations(inputannotations, convertannotations);
+    }
+
+    if (indexroot != "")
+    {
+        if (indexroot[indexroot.size() - 1] != '/') indexroot += "/";
+        if (indexfile == "") indexfile = indexroot + "dataset.index";
+        return indexDataset(indexroot, indexfile, indexthreads);
+    }
+
+    if (directvideo && videoname == "")
+    {
+        printf("--direct-video requires --input-video\n");
+        return 1;
+    }
+
+    if (framesdir == "" && !directvideo)
     {
         printf("--frames-directory is a required argument, for storing frames from input video, or loading frames from a previous session\n");
         return 1;
     }
 
-    if (framesdir[framesdir.size() - 1] != '/') framesdir += "/";
-    if (outputdir[outputdir.size() - 1] != '/') framesdir += "/";
+    if (convertframes != "")
+    {
+        return convertFrames(convertframes);
+    }
+
+    if (profilegraph)
+    {
+#ifdef USE_CAFFE
+        if (parseInferenceDevice(devicename, device) != 0) return 1;
+        if (device == InferenceDevice::CPU && cputhreads > 0) setBlasThreads(cputhreads);
+        setupInferenceDevice(device, 0);
+        return profileDeployGraph(prototxt, caffemodel, DEPLOY_OUTPUT, 50);
+#else
+        printf("--profile-graph requires the build with Caffe\n");
+        return 1;
+#endif
+    }
 
     printf("Starting program...\n");
 
-    if (videoname != "" && framesdir != "")
+    std::unique_ptr<FrameSource> source;
+    if (directvideo)
+    {
+        // only the exported frames are written, to the output directory
+        if (outputdir == "") outputdir = framesdir;
+        std::unique_ptr<VideoFrameSource> video(new VideoFrameSource(cv::Size(1024,576), seeksegment, 4));
+        if (video->open(videoname) != 0)
+        {
+            printf("Error opening video %s\n", videoname.c_str());
+            return 1;
+        }
+        source = std::move(video);
+    }
+    else if (videoname != "" && framesdir != "")
     {
-        if (getFiles(framesdir.c_str(), frames, "jpg") != 0)
+        std::vector<std::string> files;
+        if (getFiles(framesdir.c_str(), files, "jpg") != 0)
         {
             printf("%s directory does not exist or you have not right permissions\n", framesdir.c_str());
             return 1;
         }
-        else if (frames.size() > 0)
+        else if (files.size() > 0 || hasFramePack(framesdir))
         {
             printf("%s directory is not empty, run the application without input video or clear this directory\n", framesdir.c_str());
             return 1;
         }
-        printf("Converting video to jpg images...\n");
+        printf("Converting video to %s frames...\n", framestore.c_str());
 
-        cv::VideoCapture cap(videoname, cv::CAP_FFMPEG);
-
-        if (!cap.isOpened())
+        std::unique_ptr<FrameSink> sink = createFrameSink(framestore, framesdir);
+        if (!sink) return 1;
+        FrameExtractor extractor(videoname, *sink, cv::Size(1024,576), extractionthreads);
+        if (extractor.run() != 0)
         {
-            printf("Error opening video stream or file\n");
-            return -1;
+            printf("Error extracting frames from the video\n");
+            return 1;
         }
+    }
 
-        int i = 0;
-        while (true)
-        {
-            printf("Frame:  %d\n", i);
-            cv::Mat frame;
-            cap >> frame;
-            if (frame.empty()) break;
-            cv::resize(frame, frame, cv::Size(1024,576));
-            std::ostringstream path;
-            path << framesdir;
-            path << std::setfill('0') << std::setw(8) << i;
-            path << ".jpg";
-            cv::imwrite(path.str(), frame);
-            frames.push_back(path.str());
-            BoundingBox bbox;
-            bbox.x1_ = 0;
-            bbox.x2_ = 0;
-            bbox.y1_ = 0;
-            bbox.y2_ = 0;
-            staged.push_back(bbox);
-            unstaged.push_back(bbox);
-            movieid.push_back(0);
-            i++;
-        }
-        cap.release();
+    if (!directvideo) source = openFrameSource(framesdir);
+    if (!source)
+    {
+        printf("%s directory does not exist, is empty or you have not right permissions\n", framesdir.c_str());
+        return 1;
     }
-    else if (videoname == "" && framesdir != "")
+    framesource = std::unique_ptr<FrameCache>(new FrameCache(std::move(source), (size_t)framecachemb * 1024 * 1024, readahead));
+    for (int i = 0; i < framesource->size(); i++)
     {
-        if (getFiles(framesdir.c_str(), frames, "jpg") != 0)
-        {
-            printf("%s directory does not exist or you have not right permissions\n", framesdir.c_str());
-            return 1;
-        }
-        else if (frames.size() == 0)
+        movieid.push_back(0);
+    }
+    // there is an object to annotate even without annotations
+    for (size_t i = 0; i < std::max<size_t>(inputannotations.size(), 1); i++) addObject();
+
+    if (lastframe == -1) lastframe = framesource->size() - 1;
+
+    if (gapfilling != "linear" && gapfilling != "tracker")
+    {
+        printf("Unknown gap filling:  %s\n", gapfilling.c_str());
+        return 1;
+    }
+    std::vector<std::vector<TrackingGap>> gaps(objects.size());
+    for (size_t i = 0; i < inputannotations.size(); i++)
+    {
+        if (loadAnnotations(inputannotations[i], objects[i].staged, gaps[i]) != 0)
         {
-            printf("%s directory is empty\n", framesdir.c_str());
+            printf("Error loading annotations file\n");
             return 1;
         }
-        std::sort(frames.begin(), frames.end());
-        for (int i = 0; i < frames.size(); i++)
-        {
-            BoundingBox bbox;
-            bbox.x1_ = 0;
-            bbox.x2_ = 0;
-            bbox.y1_ = 0;
-            bbox.y2_ = 0;
-            staged.push_back(bbox);
-            unstaged.push_back(bbox);
-        }
     }
+    printf("Sucessfully loaded annotations\n");
+    indexStaged();
 
-    if (lastframe == -1) lastframe = frames.size() - 1;
-
-    caffe::Caffe::SetDevice(0);
-    caffe::Caffe::set_mode(caffe::Caffe::GPU);
-    printf("Set GPU Caffe mode\n");
-    tracker = std::unique_ptr<Tracker>(new Tracker(false));
-    regressor = std::unique_ptr<Regressor>(new Regressor(prototxt, caffemodel, 0, false));
+    if (benchmarkcrops)
+    {
+        return benchmarkCrops();
+    }
+    if (parseInferenceDevice(devicename, device) != 0) return 1;
+    if (comparebackends)
+    {
+        return compareBackends();
+    }
+    if (comparemodel != "")
+    {
+        return compareModels(comparemodel);
+    }
+    if (calibrateint8 != "")
+    {
+        return calibrateInt8(calibrateint8);
+    }
+    if (compareint8)
+    {
+        return compareInt8();
+    }
+    // the optical flow needs no network
+    if (trackername == "goturn")
+    {
+        regressor = createRegressor(backendname, prototxt, caffemodel);
+        if (!regressor) return 1;
+        timedregressor = std::unique_ptr<TimedRegressor>(new TimedRegressor(*regressor));
+    }
+    trackerbackend = createTrackerBackend(timedregressor.get());
+    if (!trackerbackend) return 1;
     printf("Prepared tracker structures\n");
     toogleplay = true;
     selected = false;
 
-    if (inputannotations != "")
+    if (headless)
+    {
+        int status = runHeadless(initbox);
+        regressor.release();
+        return status;
+    }
+
+    if (journalpath == "") journalpath = outputdir + "annotations.journal";
+    if (openJournal() != 0) return 1;
+    indexStaged();
+
+    // the restored session already has its gaps filled
+    if (gapfilling == "tracker" && !journal->restored())
     {
-        if (loadAnnotations(inputannotations) != 0)
+        // the linearly interpolated boxes are replaced, the filled ones are journaled
+        for (size_t i = 0; i < objects.size(); i++)
         {
-            printf("Error loading annotations file\n");
-            return 1;
+            std::vector<BoundingBox> filled = objects[i].staged;
+            if (fillGapsByTracking(objects[i].staged, gaps[i], filled) != 0) return 1;
+            stageBoxes(i, 0, (int)filled.size() - 1, filled);
         }
+        if (journal->flush() != 0) return 1;
     }
-    printf("Sucessfully loaded annotations\n");
+
+    // Caffe mode is thread-local, the tracker thread has to set it on its own
+    trackerworker = std::unique_ptr<TrackerWorker>(new TrackerWorker(*framesource, *trackerbackend, trackahead,
+        (size_t)checkpointmb * 1024 * 1024, maxdecodescale, []()
+    {
+        setupInferenceDevice(device, 0);
+    }));
+    for (size_t i = 0; i < objects.size(); i++) trackerworker->addObject();
 
     currframe = 0;
 
     cv::namedWindow("Frame", cv::WINDOW_NORMAL);
     cv::setMouseCallback("Frame",callbackfunc);
-    frame = cv::imread(frames[currframe]);
+    frame = framesource->read(currframe);
     if (!frame.data)
     {
-        printf("Frame not valid:  %s\n", frames[currframe].c_str());
+        printf("Frame not valid:  %s\n", framesource->name(currframe).c_str());
         return 1;
     }
-    printf("%s %d %d\n", frames[currframe].c_str(), frame.rows, frame.cols);
-    canvas = cv::Mat3b(frame.rows, frame.cols, cv::Vec3b(0,0,0));
-    frame.copyTo(canvas);
-
-    BoundingBox fullframe({0, 0, (float)frame.cols, (float)frame.rows});
+    printf("%s %d %d\n", framesource->name(currframe).c_str(), frame.rows, frame.cols);
+    canvas.setFrame(currframe, frame);
 
     while (true)
     {
-        frame = cv::imread(frames[currframe]);
-        frame.copyTo(canvas);
         if (toogleplay && !paused)
         {
-            if (currframe + 1 < frames.size()) currframe++;
-            frame.copyTo(canvas);
-            nextframe = true;
-        }
-        if (selected && nextframe)
-        {
-            printf("Frame:  %d\n", currframe);
-            if (toggletracking) tracker->Track(frame, regressor.get(), &_bbox);
-            else _bbox = unstaged[currframe];
-            nextframe = false;
-            _bbox.Draw(255,0,0,&canvas);
-            unstaged[currframe] = _bbox;
-            if (autostage) staged[currframe] = unstaged[currframe];
+            if (currframe + 1 < framesource->size())
+            {
+                currframe++;
+                nextframe = true;
+            }
+            else paused = true;
         }
-        unstaged[currframe].Draw(255,0,0,&canvas);
-        staged[currframe].Draw(255,255,255,&canvas);
-
-        if (firstframe == currframe) fullframe.Draw(0,255,0,&canvas);
-        if (lastframe == currframe) fullframe.Draw(0,0,255,&canvas);
+        loadCurrentFrame();
+        updateProposal();
+        framesource->prefetch(currframe, playdirection);
+        refreshView();
+        journal->flush();
 
-        cv::imshow("Frame", canvas);
-        if (!keyboardControl(cv::waitKey(waitkeyduration))) break;
+        // when paused, nothing changes until the user acts or the proposal for
+        // the current frame arrives - otherwise wait for input without polling
+        int delay = waitkeyduration;
+        if (paused) delay = (selected && nextframe && proposalsPending()) ? 10 : 0;
+        if (!keyboardControl(cv::waitKey(delay))) break;
     }
+    journal->close();
+    framesource->printStatistics();
     // need to release regressor and tracker before CUDA context is out of scope
+    trackerworker.reset();
+    segmentbackends.clear();
+    segmentregressors.clear();
+    trackerbackend->printLatency();
+    if (timedregressor) timedregressor->latency().print("Regressor latency (" + regressorname + ")");
     regressor.release();
-    tracker.release();
     return 0;
 }
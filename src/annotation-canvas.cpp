@@ -0,0 +1,85 @@
+#include "annotation-canvas.h"
+#include <algorithm>
+#include <cmath>
+
+// margin covering the thickness of the drawn rectangle lines
+static const int OVERLAY_MARGIN = 4;
+
+static bool sameOverlay(const Overlay &a, const Overlay &b)
+{
+    return a.bbox.x1_ == b.bbox.x1_ && a.bbox.y1_ == b.bbox.y1_ &&
+        a.bbox.x2_ == b.bbox.x2_ && a.bbox.y2_ == b.bbox.y2_ &&
+        a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+AnnotationCanvas::AnnotationCanvas()
+    : index(-1), framedirty(false)
+{
+}
+
+void AnnotationCanvas::setFrame(int index, const cv::Mat &frame)
+{
+    if (index == this->index && !this->frame.empty()) return;
+    this->index = index;
+    this->frame = frame;
+    framedirty = true;
+}
+
+void AnnotationCanvas::setOverlays(const std::vector<Overlay> &overlays)
+{
+    this->overlays = overlays;
+}
+
+int AnnotationCanvas::frameIndex() const
+{
+    return index;
+}
+
+cv::Rect AnnotationCanvas::dirtyRegion(const Overlay &overlay) const
+{
+    int x1 = std::floor(std::min(overlay.bbox.x1_, overlay.bbox.x2_)) - OVERLAY_MARGIN;
+    int y1 = std::floor(std::min(overlay.bbox.y1_, overlay.bbox.y2_)) - OVERLAY_MARGIN;
+    int x2 = std::ceil(std::max(overlay.bbox.x1_, overlay.bbox.x2_)) + OVERLAY_MARGIN;
+    int y2 = std::ceil(std::max(overlay.bbox.y1_, overlay.bbox.y2_)) + OVERLAY_MARGIN;
+    return cv::Rect(x1, y1, x2 - x1, y2 - y1) & cv::Rect(0, 0, frame.cols, frame.rows);
+}
+
+bool AnnotationCanvas::compose()
+{
+    if (frame.empty()) return false;
+    if (framedirty)
+    {
+        canvas.create(frame.rows, frame.cols);
+        frame.copyTo(canvas);
+    }
+    else
+    {
+        bool changed = overlays.size() != drawn.size();
+        for (size_t i = 0; !changed && i < overlays.size(); i++)
+        {
+            changed = !sameOverlay(overlays[i], drawn[i]);
+        }
+        if (!changed) return false;
+
+        // restore the frame under the previously drawn boxes
+        for (const Overlay &overlay : drawn)
+        {
+            cv::Rect region = dirtyRegion(overlay);
+            if (region.area() == 0) continue;
+            cv::Mat destination = canvas(region);
+            frame(region).copyTo(destination);
+        }
+    }
+    for (const Overlay &overlay : overlays)
+    {
+        overlay.bbox.Draw(overlay.r, overlay.g, overlay.b, &canvas);
+    }
+    drawn = overlays;
+    framedirty = false;
+    return true;
+}
+
+const cv::Mat3b &AnnotationCanvas::image() const
+{
+    return canvas;
+}
@@ -0,0 +1,59 @@
+#ifndef ANNOTATION_CANVAS_H
+#define ANNOTATION_CANVAS_H
+
+#include "helper/bounding_box.h"
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+/**
+ * Bounding box drawn on top of the frame.
+ */
+struct Overlay
+{
+    BoundingBox bbox;
+    int r, g, b;
+};
+
+/**
+ * Composes the displayed image from the frame and the bounding boxes.
+ *
+ * The canvas remembers what was drawn last time. If only the bounding
+ * boxes change, only the regions under the previous and the new boxes are
+ * restored from the frame and redrawn, and if nothing changes the canvas
+ * is left untouched.
+ */
+class AnnotationCanvas
+{
+public:
+    AnnotationCanvas();
+
+    /// Sets the displayed frame, the frame is redrawn only if index changes
+    void setFrame(int index, const cv::Mat &frame);
+
+    /// Sets the bounding boxes drawn in the given order over the frame
+    void setOverlays(const std::vector<Overlay> &overlays);
+
+    /// Returns the index of the displayed frame, -1 if none
+    int frameIndex() const;
+
+    /**
+     * Updates the canvas.
+     *
+     * Returns true if the canvas has changed and needs to be shown again.
+     */
+    bool compose();
+
+    const cv::Mat3b &image() const;
+
+private:
+    cv::Rect dirtyRegion(const Overlay &overlay) const;
+
+    cv::Mat frame;
+    cv::Mat3b canvas;
+    int index;
+    bool framedirty;
+    std::vector<Overlay> overlays;
+    std::vector<Overlay> drawn;
+};
+
+#endif
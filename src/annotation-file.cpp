@@ -0,0 +1,220 @@
+#include "annotation-file.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char *BINARY_ANNOTATIONS_EXTENSION = ".annb";
+
+static const char ANNOTATION_FILE_MAGIC[8] = {'A', 'N', 'N', 'C', 'O', 'L', 'S', '\0'};
+static const uint32_t ANNOTATION_FILE_VERSION = 1;
+
+static_assert(sizeof(AnnotationFileHeader) == 24, "Unexpected annotation file header size");
+
+static bool validHeader(const AnnotationFileHeader &header)
+{
+    return memcmp(header.magic, ANNOTATION_FILE_MAGIC, sizeof(ANNOTATION_FILE_MAGIC)) == 0 &&
+        header.version == ANNOTATION_FILE_VERSION &&
+        header.columns == ANNOTATION_COLUMNS;
+}
+
+bool isBinaryAnnotations(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    char magic[sizeof(ANNOTATION_FILE_MAGIC)];
+    bool binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+        memcmp(magic, ANNOTATION_FILE_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return binary;
+}
+
+AnnotationFile::AnnotationFile()
+    : mapping(nullptr), mappingsize(0), count(0)
+{
+    for (int c = 0; c < ANNOTATION_COLUMNS; c++) columns[c] = nullptr;
+}
+
+AnnotationFile::~AnnotationFile()
+{
+    close();
+}
+
+int AnnotationFile::open(const std::string &path)
+{
+    close();
+    if (!isBinaryAnnotations(path)) return parseText(path);
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Cannot open annotations file %s\n", path.c_str());
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(AnnotationFileHeader))
+    {
+        printf("%s is not a valid annotations file\n", path.c_str());
+        ::close(fd);
+        return 1;
+    }
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        printf("Cannot map annotations file %s\n", path.c_str());
+        return 1;
+    }
+    mapping = static_cast<const char *>(mapped);
+    mappingsize = st.st_size;
+
+    AnnotationFileHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    // the row count is checked against the size before multiplying, so it cannot overflow
+    const size_t rowsize = ANNOTATION_COLUMNS * sizeof(float);
+    if (!validHeader(header) || header.rows > (mappingsize - sizeof(header)) / rowsize ||
+        mappingsize != sizeof(header) + header.rows * rowsize)
+    {
+        printf("%s is not a valid annotations file\n", path.c_str());
+        close();
+        return 1;
+    }
+    count = header.rows;
+    const float *data = reinterpret_cast<const float *>(mapping + sizeof(header));
+    for (int c = 0; c < ANNOTATION_COLUMNS; c++) columns[c] = data + c * count;
+    return 0;
+}
+
+/// Parses the .ann lines up to the first incomplete one into the columns
+int AnnotationFile::parseText(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        printf("Annotations file not available\n");
+        return 1;
+    }
+    std::string text;
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, read);
+    fclose(file);
+
+    // the values are gathered row by row and transposed into the columns
+    std::vector<float> values;
+    const char *position = text.c_str();
+    while (true)
+    {
+        float row[ANNOTATION_COLUMNS];
+        int parsed = 0;
+        for (; parsed < ANNOTATION_COLUMNS; parsed++)
+        {
+            char *end;
+            row[parsed] = strtof(position, &end);
+            if (end == position) break;
+            position = end;
+        }
+        if (parsed < ANNOTATION_COLUMNS) break;
+        values.insert(values.end(), row, row + ANNOTATION_COLUMNS);
+    }
+    count = values.size() / ANNOTATION_COLUMNS;
+    storage.resize(values.size());
+    for (size_t r = 0; r < count; r++)
+    {
+        for (int c = 0; c < ANNOTATION_COLUMNS; c++) storage[c * count + r] = values[r * ANNOTATION_COLUMNS + c];
+    }
+    for (int c = 0; c < ANNOTATION_COLUMNS; c++) columns[c] = storage.data() + c * count;
+    return 0;
+}
+
+size_t AnnotationFile::rows() const
+{
+    return count;
+}
+
+const float *AnnotationFile::column(int column) const
+{
+    return columns[column];
+}
+
+bool AnnotationFile::binary() const
+{
+    return mapping != nullptr;
+}
+
+void AnnotationFile::close()
+{
+    if (mapping) munmap(const_cast<char *>(mapping), mappingsize);
+    mapping = nullptr;
+    mappingsize = 0;
+    storage.clear();
+    count = 0;
+    for (int c = 0; c < ANNOTATION_COLUMNS; c++) columns[c] = nullptr;
+}
+
+int writeBinaryAnnotations(const std::string &path, const AnnotationFile &annotations)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        printf("Cannot create annotations file %s\n", path.c_str());
+        return 1;
+    }
+    AnnotationFileHeader header;
+    memcpy(header.magic, ANNOTATION_FILE_MAGIC, sizeof(header.magic));
+    header.version = ANNOTATION_FILE_VERSION;
+    header.columns = ANNOTATION_COLUMNS;
+    header.rows = annotations.rows();
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int c = 0; c < ANNOTATION_COLUMNS && written; c++)
+    {
+        written = fwrite(annotations.column(c), sizeof(float), annotations.rows(), file) == annotations.rows();
+    }
+    if (fclose(file) != 0 || !written)
+    {
+        printf("Cannot write annotations file %s\n", path.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+/// Writes the shortest decimal that reads back as the same float
+static bool writeValue(FILE *file, const char *separator, float value)
+{
+    char text[32];
+    for (int precision = 6; precision <= 9; precision++)
+    {
+        snprintf(text, sizeof(text), "%.*g", precision, value);
+        if (strtof(text, nullptr) == value) break;
+    }
+    return fprintf(file, "%s%s", separator, text) > 0;
+}
+
+int writeTextAnnotations(const std::string &path, const AnnotationFile &annotations)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file)
+    {
+        printf("Cannot create annotations file %s\n", path.c_str());
+        return 1;
+    }
+    bool written = true;
+    for (size_t r = 0; r < annotations.rows() && written; r++)
+    {
+        for (int c = 0; c < ANNOTATION_COLUMNS && written; c++)
+        {
+            written = writeValue(file, c == 0 ? "" : " ", annotations.column(c)[r]);
+        }
+        written = written && fputc('\n', file) != EOF;
+    }
+    if (fclose(file) != 0 || !written)
+    {
+        printf("Cannot write annotations file %s\n", path.c_str());
+        return 1;
+    }
+    return 0;
+}
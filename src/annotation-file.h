@@ -0,0 +1,88 @@
+#ifndef ANNOTATION_FILE_H
+#define ANNOTATION_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Annotation files - the boxes of an object in the text .ann format or in
+ * the binary columnar format.
+ *
+ * The binary file is a header followed by float32 columns, each holding
+ * one value per box: the frame ids and the coordinates of the A, B, C and
+ * D corners, in the order of the .ann fields. The file is memory-mapped and
+ * the columns are used in place.
+ *
+ * The frame ids and coordinates are stored as float32 in both cases, so
+ * converting in either direction and back gives the same values.
+ */
+
+extern const char *BINARY_ANNOTATIONS_EXTENSION;
+
+enum AnnotationColumn
+{
+    ANNOTATION_ID,
+    ANNOTATION_AX,
+    ANNOTATION_AY,
+    ANNOTATION_BX,
+    ANNOTATION_BY,
+    ANNOTATION_CX,
+    ANNOTATION_CY,
+    ANNOTATION_DX,
+    ANNOTATION_DY,
+    ANNOTATION_COLUMNS
+};
+
+struct AnnotationFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t columns;
+    uint64_t rows;
+};
+
+/// Checks if the file is in the binary annotation format
+bool isBinaryAnnotations(const std::string &path);
+
+/**
+ * Read-only view of the annotation file in either format.
+ */
+class AnnotationFile
+{
+public:
+    AnnotationFile();
+    ~AnnotationFile();
+
+    /// Maps the binary file or parses the .ann file, the format is detected from the contents, returns 0 on success
+    int open(const std::string &path);
+
+    /// Number of boxes
+    size_t rows() const;
+
+    /// Values of the column, one per box
+    const float *column(int column) const;
+
+    /// Checks if the file is in the binary format
+    bool binary() const;
+
+    void close();
+
+private:
+    int parseText(const std::string &path);
+
+    const char *mapping;
+    size_t mappingsize;
+    std::vector<float> storage;
+    size_t count;
+    const float *columns[ANNOTATION_COLUMNS];
+};
+
+/// Writes the annotations in the binary format, returns 0 on success
+int writeBinaryAnnotations(const std::string &path, const AnnotationFile &annotations);
+
+/// Writes the annotations in the .ann format, returns 0 on success
+int writeTextAnnotations(const std::string &path, const AnnotationFile &annotations);
+
+#endif
@@ -0,0 +1,332 @@
+#include "annotation-journal.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char ANNOTATION_JOURNAL_MAGIC[8] = {'A', 'N', 'N', 'J', 'R', 'N', 'L', '\0'};
+static const uint32_t ANNOTATION_JOURNAL_VERSION = 2;
+/// The journal is compacted once it holds more records than this and four times more than the state needs
+static const size_t COMPACTION_RECORDS = 4096;
+
+static_assert(sizeof(AnnotationJournalHeader) == 24, "Unexpected annotation journal header size");
+static_assert(sizeof(AnnotationRecord) == 32, "Unexpected annotation record size");
+
+/// FNV-1a hash of the record without the checksum
+static uint32_t recordChecksum(const AnnotationRecord &record)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(AnnotationRecord, checksum); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool writeAll(int fd, const void *buffer, size_t size)
+{
+    const char *ptr = static_cast<const char *>(buffer);
+    while (size > 0)
+    {
+        ssize_t written = write(fd, ptr, size);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        ptr += written;
+        size -= written;
+    }
+    return true;
+}
+
+/// A record with the unused bytes zeroed, so they do not change the checksum
+static AnnotationRecord newRecord(uint32_t type, int object, int frame)
+{
+    AnnotationRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.object = object;
+    record.frame = frame;
+    return record;
+}
+
+static BoundingBox noBox()
+{
+    BoundingBox box;
+    box.x1_ = 0;
+    box.y1_ = 0;
+    box.x2_ = 0;
+    box.y2_ = 0;
+    return box;
+}
+
+static bool emptyBox(const BoundingBox &box)
+{
+    return box.x1_ == 0 && box.y1_ == 0 && box.x2_ == 0 && box.y2_ == 0;
+}
+
+/// Syncs the directory holding the file, so that the renamed file survives a crash
+static void syncDirectory(const std::string &path)
+{
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    ::close(fd);
+}
+
+AnnotationJournal::AnnotationJournal()
+    : fd(-1), frames(0), records(0), replayed(false)
+{
+}
+
+AnnotationJournal::~AnnotationJournal()
+{
+    close();
+}
+
+int AnnotationJournal::open(const std::string &path, int frames)
+{
+    close();
+    this->path = path;
+    this->frames = frames;
+    current = AnnotationState();
+    current.lastframe = frames - 1;
+    records = 0;
+    replayed = false;
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        printf("Cannot open annotation journal %s\n", path.c_str());
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        printf("Cannot read annotation journal %s\n", path.c_str());
+        close();
+        return 1;
+    }
+    // an empty journal is written from scratch by reset()
+    if (st.st_size < (off_t)sizeof(AnnotationJournalHeader)) return 0;
+
+    std::vector<char> data(st.st_size);
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        ssize_t count = pread(fd, data.data() + offset, data.size() - offset, offset);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0)
+        {
+            printf("Cannot read annotation journal %s\n", path.c_str());
+            close();
+            return 1;
+        }
+        offset += count;
+    }
+    AnnotationJournalHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, ANNOTATION_JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != ANNOTATION_JOURNAL_VERSION || header.recordsize != sizeof(AnnotationRecord))
+    {
+        printf("%s is not a valid annotation journal\n", path.c_str());
+        close();
+        return 1;
+    }
+    if ((int)header.frames != frames)
+    {
+        printf("Annotation journal %s is for %u frames, the sequence has %d\n", path.c_str(), header.frames, frames);
+        close();
+        return 1;
+    }
+
+    size_t end = sizeof(header);
+    while (end + sizeof(AnnotationRecord) <= data.size())
+    {
+        AnnotationRecord record;
+        memcpy(&record, data.data() + end, sizeof(record));
+        if (record.checksum != recordChecksum(record) || !apply(record)) break;
+        end += sizeof(record);
+        records++;
+    }
+    if (end < data.size())
+    {
+        printf("Discarding %d bytes of the annotation journal after the last complete record\n", (int)(data.size() - end));
+        if (ftruncate(fd, end) != 0)
+        {
+            printf("Cannot truncate annotation journal %s\n", path.c_str());
+            close();
+            return 1;
+        }
+    }
+    lseek(fd, end, SEEK_SET);
+    replayed = !current.staged.empty();
+    return 0;
+}
+
+bool AnnotationJournal::restored() const
+{
+    return replayed;
+}
+
+const AnnotationState &AnnotationJournal::state() const
+{
+    return current;
+}
+
+int AnnotationJournal::reset(const AnnotationState &state)
+{
+    current = state;
+    pending.clear();
+    return rewrite();
+}
+
+void AnnotationJournal::stage(int object, int frame, const BoundingBox &box)
+{
+    AnnotationRecord record = newRecord(JOURNAL_STAGE, object, frame);
+    record.box[0] = box.x1_;
+    record.box[1] = box.y1_;
+    record.box[2] = box.x2_;
+    record.box[3] = box.y2_;
+    append(record);
+}
+
+void AnnotationJournal::stage(int object, int first, int last, const std::vector<BoundingBox> &boxes)
+{
+    if (object < 0 || object >= (int)current.staged.size()) return;
+    const std::vector<BoundingBox> &staged = current.staged[object];
+    for (int frame = first; frame <= last; frame++)
+    {
+        const BoundingBox &box = boxes[frame];
+        if (staged[frame].x1_ != box.x1_ || staged[frame].y1_ != box.y1_ || staged[frame].x2_ != box.x2_ || staged[frame].y2_ != box.y2_)
+            stage(object, frame, box);
+    }
+}
+
+bool AnnotationJournal::setRange(int firstframe, int lastframe)
+{
+    AnnotationRecord record = newRecord(JOURNAL_RANGE, -1, firstframe);
+    record.lastframe = lastframe;
+    return append(record);
+}
+
+void AnnotationJournal::addObject()
+{
+    append(newRecord(JOURNAL_OBJECT, 0, 0));
+}
+
+/// Computes the checksum and applies the record, only the valid records are appended
+bool AnnotationJournal::append(AnnotationRecord record)
+{
+    record.checksum = recordChecksum(record);
+    if (!apply(record)) return false;
+    pending.push_back(record);
+    return true;
+}
+
+bool AnnotationJournal::apply(const AnnotationRecord &record)
+{
+    switch (record.type)
+    {
+    case JOURNAL_STAGE:
+    {
+        if (record.object < 0 || record.object >= (int)current.staged.size() || record.frame < 0 || record.frame >= frames) return false;
+        BoundingBox &box = current.staged[record.object][record.frame];
+        box.x1_ = record.box[0];
+        box.y1_ = record.box[1];
+        box.x2_ = record.box[2];
+        box.y2_ = record.box[3];
+        return true;
+    }
+    case JOURNAL_RANGE:
+        if (record.object != -1 || record.frame < 0 || record.lastframe < record.frame || record.lastframe >= frames) return false;
+        current.firstframe = record.frame;
+        current.lastframe = record.lastframe;
+        return true;
+    case JOURNAL_OBJECT:
+        current.staged.push_back(std::vector<BoundingBox>(frames, noBox()));
+        return true;
+    default:
+        return false;
+    }
+}
+
+int AnnotationJournal::flush()
+{
+    if (fd < 0 || pending.empty()) return 0;
+    if (!writeAll(fd, pending.data(), pending.size() * sizeof(AnnotationRecord)) || fdatasync(fd) != 0)
+    {
+        printf("Cannot write annotation journal %s\n", path.c_str());
+        return 1;
+    }
+    records += pending.size();
+    pending.clear();
+
+    size_t needed = 1 + current.staged.size();
+    for (const std::vector<BoundingBox> &staged : current.staged)
+    {
+        for (const BoundingBox &box : staged)
+        {
+            if (!emptyBox(box)) needed++;
+        }
+    }
+    if (records > COMPACTION_RECORDS && records > 4 * needed) return rewrite();
+    return 0;
+}
+
+/// Writes the current state as a new journal and replaces the old one with it
+int AnnotationJournal::rewrite()
+{
+    std::vector<AnnotationRecord> snapshot;
+    AnnotationState state = current;
+    current.staged.clear();
+    pending.clear();
+    for (size_t object = 0; object < state.staged.size(); object++) addObject();
+    setRange(state.firstframe, state.lastframe);
+    for (size_t object = 0; object < state.staged.size(); object++)
+    {
+        for (int frame = 0; frame < frames; frame++)
+        {
+            if (!emptyBox(state.staged[object][frame])) stage(object, frame, state.staged[object][frame]);
+        }
+    }
+    snapshot.swap(pending);
+
+    AnnotationJournalHeader header;
+    memcpy(header.magic, ANNOTATION_JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = ANNOTATION_JOURNAL_VERSION;
+    header.recordsize = sizeof(AnnotationRecord);
+    header.frames = frames;
+    header.reserved = 0;
+
+    std::string temporary = path + ".tmp";
+    int newfd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (newfd < 0 || !writeAll(newfd, &header, sizeof(header)) ||
+        !writeAll(newfd, snapshot.data(), snapshot.size() * sizeof(AnnotationRecord)) ||
+        fdatasync(newfd) != 0 || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        printf("Cannot write annotation journal %s\n", temporary.c_str());
+        if (newfd >= 0) ::close(newfd);
+        return 1;
+    }
+    syncDirectory(path);
+    if (fd >= 0) ::close(fd);
+    fd = newfd;
+    records = snapshot.size();
+    return 0;
+}
+
+void AnnotationJournal::close()
+{
+    flush();
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
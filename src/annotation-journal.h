@@ -0,0 +1,119 @@
+#ifndef ANNOTATION_JOURNAL_H
+#define ANNOTATION_JOURNAL_H
+
+#include "helper/bounding_box.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Annotation journal - write-ahead log of the staged boxes.
+ *
+ * Every change of the staged boxes, of the first and last frame and of the
+ * number of objects is appended to the journal as a fixed-size record with
+ * a checksum, so the annotation session can be restored after a crash by
+ * replaying the journal. A record torn by a crash fails the checksum, the
+ * replay stops there and the journal is truncated to the valid records.
+ *
+ * Once the journal grows much larger than the state it describes, it is
+ * compacted - the state is written to a new journal which then replaces
+ * the old one.
+ */
+
+struct AnnotationJournalHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordsize;
+    uint32_t frames;
+    uint32_t reserved;
+};
+
+/// STAGE sets the staged box of the object in the frame, RANGE sets the first and the last frame, OBJECT adds an object
+enum AnnotationRecordType : uint32_t
+{
+    JOURNAL_STAGE = 1,
+    JOURNAL_RANGE = 2,
+    JOURNAL_OBJECT = 3
+};
+
+/**
+ * Record of the journal. A STAGE record uses the object, the frame and the
+ * box, a RANGE record has the first frame in frame, the last one in
+ * lastframe and object -1, an OBJECT record uses none of them. The unused
+ * bytes are zero.
+ */
+struct AnnotationRecord
+{
+    uint32_t type;
+    int32_t object;
+    int32_t frame;
+    union
+    {
+        float box[4];
+        int32_t lastframe;
+    };
+    uint32_t checksum;
+};
+
+/// State of the annotation session kept in the journal
+struct AnnotationState
+{
+    int firstframe = 0;
+    int lastframe = -1;
+    /// Staged boxes of each object, one per frame
+    std::vector<std::vector<BoundingBox>> staged;
+};
+
+class AnnotationJournal
+{
+public:
+    AnnotationJournal();
+    ~AnnotationJournal();
+
+    /**
+     * Opens the journal of a sequence of frames, creating it if it does not
+     * exist, and replays its records. Returns 0 on success.
+     */
+    int open(const std::string &path, int frames);
+
+    /// Checks if open() has restored any objects from the journal
+    bool restored() const;
+
+    /// The state after the records appended so far
+    const AnnotationState &state() const;
+
+    /// Starts the journal over with the state, returns 0 on success
+    int reset(const AnnotationState &state);
+
+    void stage(int object, int frame, const BoundingBox &box);
+    /// Stages the boxes of the object from first to last frame, appending only the changed ones
+    void stage(int object, int first, int last, const std::vector<BoundingBox> &boxes);
+    /// Returns false without appending anything if the range is not within the frames
+    bool setRange(int firstframe, int lastframe);
+    void addObject();
+
+    /**
+     * Writes the records appended since the last call to the disk, and
+     * compacts the journal once it is large enough. Returns 0 on success.
+     */
+    int flush();
+
+    void close();
+
+private:
+    bool append(AnnotationRecord record);
+    bool apply(const AnnotationRecord &record);
+    int rewrite();
+
+    std::string path;
+    int fd;
+    int frames;
+    AnnotationState current;
+    std::vector<AnnotationRecord> pending;
+    /// Number of records in the journal file
+    size_t records;
+    bool replayed;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * Blocking FIFO queue with a fixed capacity.
+ *
+ * push() blocks while the queue is full, pop() blocks while it is empty.
+ * After close() is called, push() is rejected and pop() drains the remaining
+ * elements and then returns false.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    bool push(T value)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notfull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(value));
+        notempty.notify_one();
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notempty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        value = std::move(items.front());
+        items.pop_front();
+        notfull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notempty.notify_all();
+        notfull.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notempty;
+    std::condition_variable notfull;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#include "box-regressor.h"
+#include "network-input.h"
+
+void BoxRegressor::regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    std::vector<cv::Mat> targetimages, searchimages;
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        targetimages.push_back(networkInputImage(targets[i]));
+        searchimages.push_back(networkInputImage(searches[i]));
+    }
+    regressBatch(targetimages, searchimages, estimates);
+}
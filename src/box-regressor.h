@@ -0,0 +1,62 @@
+#ifndef BOX_REGRESSOR_H
+#define BOX_REGRESSOR_H
+
+#include "helper/bounding_box.h"
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+/// Side of the square crops the GOTURN network takes as inputs
+const int NETWORK_INPUT_SIZE = 227;
+
+/// Per-channel BGR mean subtracted from the network inputs
+const float NETWORK_MEAN[3] = { 104, 117, 123 };
+
+/// Number of values of a preprocessed network input - planar, 3 x size x size
+const int NETWORK_INPUT_VALUES = 3 * NETWORK_INPUT_SIZE * NETWORK_INPUT_SIZE;
+
+/**
+ * GOTURN network estimating the location of the target in the search region.
+ *
+ * Implemented by each inference backend. Unlike GOTURN's RegressorBase it
+ * does not depend on Caffe, so the application can be built without it.
+ */
+class BoxRegressor
+{
+public:
+    virtual ~BoxRegressor() {}
+
+    /**
+     * Estimates the box of the target crop in the search region crop.
+     *
+     * The estimate is the raw network output - the box in the search region
+     * coordinates, scaled by GOTURN's scale factor.
+     */
+    virtual void regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate) = 0;
+
+    /**
+     * Estimates the boxes of several target and search region pairs, e.g.
+     * of all objects tracked in a frame.
+     *
+     * Backends supporting batches run all pairs in a single forward pass,
+     * the default implementation regresses them one by one.
+     */
+    virtual void regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+        std::vector<BoundingBox> &estimates)
+    {
+        estimates.resize(targets.size());
+        for (size_t i = 0; i < targets.size(); i++) regress(targets[i], searches[i], estimates[i]);
+    }
+
+    /**
+     * Estimates the boxes from the already preprocessed inputs (see
+     * cropNetworkInput()), NETWORK_INPUT_VALUES each.
+     *
+     * Backends reading the planar inputs directly skip the preprocessing,
+     * the default implementation converts the inputs back to images for
+     * regressBatch().
+     */
+    virtual void regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+        std::vector<BoundingBox> &estimates);
+};
+
+#endif
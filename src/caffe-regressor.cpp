@@ -0,0 +1,66 @@
+#include "caffe-regressor.h"
+#include "deploy-graph.h"
+#include <algorithm>
+#include <unistd.h>
+
+void CaffeNetwork::forwardInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    const int count = targets.size();
+    caffe::Blob<float> *targetblob = net_->blob_by_name("target").get();
+    caffe::Blob<float> *searchblob = net_->blob_by_name("image").get();
+    std::vector<int> shape = { count, 3, NETWORK_INPUT_SIZE, NETWORK_INPUT_SIZE };
+    targetblob->Reshape(shape);
+    searchblob->Reshape(shape);
+    net_->Reshape();
+    float *targetdata = targetblob->mutable_cpu_data();
+    float *searchdata = searchblob->mutable_cpu_data();
+    for (int i = 0; i < count; i++)
+    {
+        std::copy(targets[i], targets[i] + NETWORK_INPUT_VALUES, targetdata + i * NETWORK_INPUT_VALUES);
+        std::copy(searches[i], searches[i] + NETWORK_INPUT_VALUES, searchdata + i * NETWORK_INPUT_VALUES);
+    }
+    net_->Forward();
+
+    const float *output = net_->blob_by_name(DEPLOY_OUTPUT)->cpu_data();
+    estimates.clear();
+    for (int i = 0; i < count; i++)
+    {
+        const float *values = output + 4 * i;
+        estimates.push_back(BoundingBox(std::vector<float>(values, values + 4)));
+    }
+}
+
+int CaffeRegressor::load(const std::string &prototxt, const std::string &caffemodel, bool fullgraph)
+{
+    if (fullgraph)
+    {
+        regressor.reset(new CaffeNetwork(prototxt, caffemodel, 0, false));
+        return 0;
+    }
+    int inputs;
+    std::string deploy = createDeployGraph(prototxt, DEPLOY_OUTPUT, inputs);
+    if (deploy.empty()) return 1;
+    regressor.reset(new CaffeNetwork(deploy, caffemodel, 0, inputs, false));
+    unlink(deploy.c_str());
+    return 0;
+}
+
+void CaffeRegressor::regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate)
+{
+    // the current frame argument is not used by the Regressor
+    regressor->Regress(search, search, target, &estimate);
+}
+
+void CaffeRegressor::regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    estimates.clear();
+    regressor->Regress(cv::Mat(), searches, targets, &estimates);
+}
+
+void CaffeRegressor::regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    regressor->forwardInputs(targets, searches, estimates);
+}
@@ -0,0 +1,49 @@
+#ifndef CAFFE_REGRESSOR_H
+#define CAFFE_REGRESSOR_H
+
+#include "box-regressor.h"
+#include "network/regressor.h"
+#include <memory>
+#include <string>
+
+/**
+ * GOTURN's Regressor with a forward pass on the preprocessed inputs, which
+ * needs its network.
+ */
+class CaffeNetwork : public Regressor
+{
+public:
+    using Regressor::Regressor;
+
+    /// Copies the planar inputs into the input blobs reshaped to their number and runs the network
+    void forwardInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+        std::vector<BoundingBox> &estimates);
+};
+
+/**
+ * Runs the network with Caffe, through GOTURN's Regressor.
+ */
+class CaffeRegressor : public BoxRegressor
+{
+public:
+    /**
+     * Loads the network. Unless fullgraph is set, the layers not needed for
+     * inference are removed from the prototxt first. Returns 0 on success.
+     */
+    int load(const std::string &prototxt, const std::string &caffemodel, bool fullgraph);
+
+    void regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate) override;
+
+    /// The input blobs are reshaped to the batch size, overriding the input_dim of the prototxt
+    void regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+    /// The inputs are copied straight into the input blobs, without GOTURN's preprocessing
+    void regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+private:
+    std::unique_ptr<CaffeNetwork> regressor;
+};
+
+#endif
@@ -0,0 +1,352 @@
+#include "caffemodel-reader.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+// protobuf wire types
+const int VARINT = 0;
+const int FIXED64 = 1;
+const int LENGTH_DELIMITED = 2;
+const int FIXED32 = 5;
+
+// caffe.proto field numbers
+const int NET_LAYERS_V1 = 2;
+const int NET_LAYER = 100;
+const int LAYER_NAME = 1;
+const int LAYER_BLOBS = 7;
+const int LAYER_V1_NAME = 4;
+const int LAYER_V1_BLOBS = 6;
+const int BLOB_NUM = 1;
+const int BLOB_CHANNELS = 2;
+const int BLOB_HEIGHT = 3;
+const int BLOB_WIDTH = 4;
+const int BLOB_DATA = 5;
+const int BLOB_SHAPE = 7;
+const int SHAPE_DIM = 1;
+
+/**
+ * Sequential reader of the protobuf fields of a message.
+ */
+class WireReader
+{
+public:
+    WireReader(const uint8_t *begin, const uint8_t *end) : position(begin), end(end), error(false) {}
+
+    bool failed() const { return error; }
+
+    /// Reads the next field key, returns false at the end of the message
+    bool next(int &field, int &type)
+    {
+        if (position >= end || error) return false;
+        uint64_t key = varint();
+        field = key >> 3;
+        type = key & 7;
+        return !error;
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && position < end; shift += 7)
+        {
+            uint8_t byte = *position++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        error = true;
+        return 0;
+    }
+
+    float fixed32()
+    {
+        float value = 0;
+        if (end - position < 4)
+        {
+            error = true;
+            return value;
+        }
+        memcpy(&value, position, 4);
+        position += 4;
+        return value;
+    }
+
+    /// Returns the reader of a length-delimited field
+    WireReader nested()
+    {
+        uint64_t length = varint();
+        if (error || length > (uint64_t)(end - position))
+        {
+            error = true;
+            return WireReader(end, end);
+        }
+        WireReader reader(position, position + length);
+        position += length;
+        return reader;
+    }
+
+    void skip(int type)
+    {
+        switch (type)
+        {
+            case VARINT:
+                varint();
+                break;
+            case FIXED64:
+                if (end - position < 8) error = true;
+                else position += 8;
+                break;
+            case LENGTH_DELIMITED:
+                nested();
+                break;
+            case FIXED32:
+                if (end - position < 4) error = true;
+                else position += 4;
+                break;
+            default:
+                // groups are not used by caffe.proto
+                error = true;
+        }
+    }
+
+    bool atEnd() const { return position >= end; }
+
+    const uint8_t *current() const { return position; }
+    size_t remaining() const { return end - position; }
+
+private:
+    const uint8_t *position;
+    const uint8_t *end;
+    bool error;
+};
+
+/**
+ * Appends protobuf fields to a message.
+ */
+class WireWriter
+{
+public:
+    void varint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back((char)(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back((char)value);
+    }
+
+    void key(int field, int type)
+    {
+        varint((uint64_t)field << 3 | type);
+    }
+
+    void bytes(int field, const void *data, size_t size)
+    {
+        key(field, LENGTH_DELIMITED);
+        varint(size);
+        buffer.append((const char *)data, size);
+    }
+
+    void message(int field, const WireWriter &nested)
+    {
+        bytes(field, nested.buffer.data(), nested.buffer.size());
+    }
+
+    std::string buffer;
+};
+
+bool readShape(WireReader reader, std::vector<int> &shape)
+{
+    int field, type;
+    while (reader.next(field, type))
+    {
+        if (field == SHAPE_DIM && type == LENGTH_DELIMITED)
+        {
+            WireReader packed = reader.nested();
+            while (!packed.atEnd() && !packed.failed()) shape.push_back(packed.varint());
+            if (packed.failed()) return false;
+        }
+        else if (field == SHAPE_DIM && type == VARINT)
+        {
+            shape.push_back(reader.varint());
+        }
+        else
+        {
+            reader.skip(type);
+        }
+    }
+    return !reader.failed();
+}
+
+bool readBlob(WireReader reader, CaffeBlob &blob)
+{
+    // legacy 4D shape, used when the blob has no shape field
+    int legacy[4] = { 0, 0, 0, 0 };
+    bool haslegacy = false;
+
+    int field, type;
+    while (reader.next(field, type))
+    {
+        if (field == BLOB_DATA && type == LENGTH_DELIMITED)
+        {
+            WireReader packed = reader.nested();
+            size_t count = packed.remaining() / 4;
+            size_t offset = blob.data.size();
+            blob.data.resize(offset + count);
+            memcpy(blob.data.data() + offset, packed.current(), count * 4);
+        }
+        else if (field == BLOB_DATA && type == FIXED32)
+        {
+            blob.data.push_back(reader.fixed32());
+        }
+        else if (field == BLOB_SHAPE && type == LENGTH_DELIMITED)
+        {
+            if (!readShape(reader.nested(), blob.shape)) return false;
+        }
+        else if (field >= BLOB_NUM && field <= BLOB_WIDTH && type == VARINT)
+        {
+            legacy[field - BLOB_NUM] = reader.varint();
+            haslegacy = true;
+        }
+        else
+        {
+            reader.skip(type);
+        }
+    }
+    if (blob.shape.empty() && haslegacy) blob.shape.assign(legacy, legacy + 4);
+    return !reader.failed();
+}
+
+bool readLayer(WireReader reader, int namefield, int blobsfield, CaffeWeights &weights)
+{
+    std::string name;
+    std::vector<CaffeBlob> blobs;
+
+    int field, type;
+    while (reader.next(field, type))
+    {
+        if (field == namefield && type == LENGTH_DELIMITED)
+        {
+            WireReader value = reader.nested();
+            name.assign((const char *)value.current(), value.remaining());
+        }
+        else if (field == blobsfield && type == LENGTH_DELIMITED)
+        {
+            blobs.push_back(CaffeBlob());
+            if (!readBlob(reader.nested(), blobs.back())) return false;
+        }
+        else
+        {
+            reader.skip(type);
+        }
+    }
+    if (reader.failed()) return false;
+    if (!blobs.empty()) weights[name] = std::move(blobs);
+    return true;
+}
+
+}
+
+int readCaffemodel(const std::string &filename, CaffeWeights &weights)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Unable to open the model:  %s\n", filename.c_str());
+        return 1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        printf("Unable to read the model:  %s\n", filename.c_str());
+        close(fd);
+        return 1;
+    }
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("Unable to map the model:  %s\n", filename.c_str());
+        return 1;
+    }
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+    const uint8_t *begin = (const uint8_t *)data;
+    WireReader reader(begin, begin + info.st_size);
+    bool valid = true;
+    int field, type;
+    while (valid && reader.next(field, type))
+    {
+        if (field == NET_LAYER && type == LENGTH_DELIMITED)
+        {
+            valid = readLayer(reader.nested(), LAYER_NAME, LAYER_BLOBS, weights);
+        }
+        else if (field == NET_LAYERS_V1 && type == LENGTH_DELIMITED)
+        {
+            valid = readLayer(reader.nested(), LAYER_V1_NAME, LAYER_V1_BLOBS, weights);
+        }
+        else
+        {
+            reader.skip(type);
+        }
+    }
+    munmap(data, info.st_size);
+
+    if (!valid || reader.failed())
+    {
+        printf("The model is corrupted:  %s\n", filename.c_str());
+        weights.clear();
+        return 1;
+    }
+    if (weights.empty())
+    {
+        printf("The model contains no weights:  %s\n", filename.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int writeCaffemodel(const std::string &filename, const CaffeWeights &weights)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        printf("Unable to create the model:  %s\n", filename.c_str());
+        return 1;
+    }
+    // layers are written one by one, so only a single layer is held in the buffer
+    for (const CaffeWeights::value_type &layer : weights)
+    {
+        WireWriter message;
+        message.bytes(LAYER_NAME, layer.first.data(), layer.first.size());
+        for (const CaffeBlob &blob : layer.second)
+        {
+            WireWriter shape;
+            WireWriter dims;
+            for (int dim : blob.shape) dims.varint(dim);
+            shape.message(SHAPE_DIM, dims);
+
+            WireWriter encoded;
+            encoded.bytes(BLOB_DATA, blob.data.data(), blob.data.size() * sizeof(float));
+            encoded.message(BLOB_SHAPE, shape);
+            message.message(LAYER_BLOBS, encoded);
+        }
+        WireWriter net;
+        net.message(NET_LAYER, message);
+        file.write(net.buffer.data(), net.buffer.size());
+    }
+    if (!file)
+    {
+        printf("Unable to write the model:  %s\n", filename.c_str());
+        return 1;
+    }
+    return 0;
+}
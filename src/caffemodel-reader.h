@@ -0,0 +1,37 @@
+#ifndef CAFFEMODEL_READER_H
+#define CAFFEMODEL_READER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Weights or biases of a layer.
+ */
+struct CaffeBlob
+{
+    std::vector<int> shape;
+    std::vector<float> data;
+};
+
+typedef std::map<std::string, std::vector<CaffeBlob>> CaffeWeights;
+
+/**
+ * Reads the learned blobs of all layers from a binary .caffemodel file.
+ *
+ * Decodes the protobuf wire format directly, so the weights can be loaded
+ * without Caffe or protobuf. Both the current (layer) and the legacy V1
+ * (layers) network formats are supported. Returns 0 on success.
+ */
+int readCaffemodel(const std::string &filename, CaffeWeights &weights);
+
+/**
+ * Writes the blobs to a binary .caffemodel file, one layer per entry.
+ *
+ * Only the names and the blobs of the layers are written, which is all
+ * Caffe and OpenCV use to copy trained weights into a network created
+ * from a prototxt. Returns 0 on success.
+ */
+int writeCaffemodel(const std::string &filename, const CaffeWeights &weights);
+
+#endif
@@ -0,0 +1,306 @@
+#include "dataset-index.h"
+#include "annotation-file.h"
+#include "frame-pack.h"
+#include "latency-stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+
+static const char *DATASET_INDEX_HEADER = "# alov-dataset-index 2";
+
+namespace
+{
+
+struct FileEntry
+{
+    std::string name;
+    off_t size;
+    uint64_t mtime;
+};
+
+uint64_t modificationTime(const struct stat &st)
+{
+    return (uint64_t)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+}
+
+/// FNV-1a hash step over the bytes of the value
+void hashBytes(uint64_t &hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+bool hasSuffix(const std::string &name, const std::string &suffix)
+{
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool isFrame(const std::string &name)
+{
+    return hasSuffix(name, ".jpg") || hasSuffix(name, ".jpeg") || hasSuffix(name, ".png");
+}
+
+bool isAnnotations(const std::string &name)
+{
+    return name.compare(0, 11, "annotations") == 0 && (hasSuffix(name, ".ann") || hasSuffix(name, BINARY_ANNOTATIONS_EXTENSION));
+}
+
+/// Parses the range of annotations<first>-<last>[-object<n>].ann, returns false for other names
+bool exportedRange(const std::string &name, int &first, int &last)
+{
+    return sscanf(name.c_str(), "annotations%d-%d", &first, &last) == 2;
+}
+
+int sizeBin(double width, double height)
+{
+    double size = std::sqrt(std::max(0.0, width * height));
+    int bin = 0;
+    for (double limit = 16; bin < BOX_SIZE_BINS - 1 && size >= limit; limit *= 2) bin++;
+    return bin;
+}
+
+/**
+ * Lists the sequence directory, fills the name, the frame count and the
+ * signature of the entry and returns the annotation files.
+ */
+bool listSequence(const std::string &directory, SequenceIndex &entry, std::vector<FileEntry> &annotations)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (!dir) return false;
+    struct stat st;
+    uint64_t hash = 14695981039346656037ull;
+    if (stat(directory.c_str(), &st) == 0)
+    {
+        uint64_t mtime = modificationTime(st);
+        hashBytes(hash, &mtime, sizeof(mtime));
+    }
+    entry.frames = 0;
+    while (struct dirent *file = readdir(dir))
+    {
+        std::string name = file->d_name;
+        if (isFrame(name)) entry.frames++;
+        else if (isAnnotations(name) && stat((directory + name).c_str(), &st) == 0)
+        {
+            annotations.push_back({ name, st.st_size, modificationTime(st) });
+        }
+    }
+    closedir(dir);
+    if (entry.frames == 0 && hasFramePack(directory) && stat((directory + FRAME_PACK_INDEX).c_str(), &st) == 0)
+    {
+        entry.frames = (st.st_size - sizeof(FramePackHeader)) / sizeof(FramePackEntry);
+    }
+
+    // the order of readdir is arbitrary
+    std::sort(annotations.begin(), annotations.end(), [](const FileEntry &a, const FileEntry &b) { return a.name < b.name; });
+    for (const FileEntry &file : annotations)
+    {
+        hashBytes(hash, file.name.data(), file.name.size());
+        hashBytes(hash, &file.size, sizeof(file.size));
+        hashBytes(hash, &file.mtime, sizeof(file.mtime));
+    }
+    entry.signature = hash;
+    entry.annotationfiles = annotations.size();
+    return true;
+}
+
+/// Parses the annotation files of the sequence into the entry
+void scanAnnotations(const std::string &directory, const std::vector<FileEntry> &files, SequenceIndex &entry)
+{
+    entry.boxes = 0;
+    entry.missing = 0;
+    entry.outofrange = 0;
+    entry.overlaps = 0;
+    std::fill(entry.sizes, entry.sizes + BOX_SIZE_BINS, 0);
+    std::vector<std::pair<int, int>> ranges;
+    for (const FileEntry &file : files)
+    {
+        int first, last;
+        if (exportedRange(file.name, first, last)) ranges.push_back({ first, last });
+
+        AnnotationFile annotations;
+        if (annotations.open(directory + file.name) != 0) continue;
+        const float *ids = annotations.column(ANNOTATION_ID);
+        const float *columns[ANNOTATION_COLUMNS];
+        for (int c = 0; c < ANNOTATION_COLUMNS; c++) columns[c] = annotations.column(c);
+        for (size_t row = 0; row < annotations.rows(); row++)
+        {
+            float x1 = std::min(std::min(columns[ANNOTATION_AX][row], columns[ANNOTATION_BX][row]), std::min(columns[ANNOTATION_CX][row], columns[ANNOTATION_DX][row]));
+            float x2 = std::max(std::max(columns[ANNOTATION_AX][row], columns[ANNOTATION_BX][row]), std::max(columns[ANNOTATION_CX][row], columns[ANNOTATION_DX][row]));
+            float y1 = std::min(std::min(columns[ANNOTATION_AY][row], columns[ANNOTATION_BY][row]), std::min(columns[ANNOTATION_CY][row], columns[ANNOTATION_DY][row]));
+            float y2 = std::max(std::max(columns[ANNOTATION_AY][row], columns[ANNOTATION_BY][row]), std::max(columns[ANNOTATION_CY][row], columns[ANNOTATION_DY][row]));
+            entry.sizes[sizeBin(x2 - x1, y2 - y1)]++;
+            if (row > 0 && ids[row] - ids[row - 1] > 1) entry.missing += (int64_t)(ids[row] - ids[row - 1]) - 1;
+            // the ids start from 1
+            if (entry.frames > 0 && ids[row] > entry.frames) entry.outofrange++;
+        }
+        entry.boxes += annotations.rows();
+    }
+
+    // the objects of one export share the range, the last frame is not exported
+    std::sort(ranges.begin(), ranges.end());
+    ranges.erase(std::unique(ranges.begin(), ranges.end()), ranges.end());
+    for (size_t a = 0; a < ranges.size(); a++)
+    {
+        for (size_t b = a + 1; b < ranges.size() && ranges[b].first < ranges[a].second; b++) entry.overlaps++;
+    }
+}
+
+/// Reads the entries of the index file, a missing file gives no entries
+std::unordered_map<std::string, SequenceIndex> readIndex(const std::string &indexfile)
+{
+    std::unordered_map<std::string, SequenceIndex> entries;
+    FILE *file = fopen(indexfile.c_str(), "r");
+    if (!file) return entries;
+    char line[4096];
+    if (!fgets(line, sizeof(line), file) || strncmp(line, DATASET_INDEX_HEADER, strlen(DATASET_INDEX_HEADER)) != 0)
+    {
+        printf("Ignoring %s, it is not a dataset index\n", indexfile.c_str());
+        fclose(file);
+        return entries;
+    }
+    while (fgets(line, sizeof(line), file))
+    {
+        char *tab = strchr(line, '\t');
+        if (!tab) continue;
+        SequenceIndex entry;
+        entry.name = std::string(line, tab - line);
+        char *position = tab + 1;
+        entry.signature = strtoull(position, &position, 16);
+        entry.frames = strtoll(position, &position, 10);
+        entry.annotationfiles = strtol(position, &position, 10);
+        entry.boxes = strtoll(position, &position, 10);
+        entry.missing = strtoll(position, &position, 10);
+        entry.outofrange = strtoll(position, &position, 10);
+        entry.overlaps = strtol(position, &position, 10);
+        for (int bin = 0; bin < BOX_SIZE_BINS; bin++) entry.sizes[bin] = strtoll(position, &position, 10);
+        entries[entry.name] = entry;
+    }
+    fclose(file);
+    return entries;
+}
+
+int writeIndex(const std::string &indexfile, const std::vector<SequenceIndex> &entries)
+{
+    std::string temporary = indexfile + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "w");
+    if (!file)
+    {
+        printf("Cannot create dataset index %s\n", indexfile.c_str());
+        return 1;
+    }
+    fprintf(file, "%s\n", DATASET_INDEX_HEADER);
+    for (const SequenceIndex &entry : entries)
+    {
+        fprintf(file, "%s\t%016llx\t%lld\t%d\t%lld\t%lld\t%lld\t%d", entry.name.c_str(), (unsigned long long)entry.signature,
+            (long long)entry.frames, entry.annotationfiles, (long long)entry.boxes, (long long)entry.missing,
+            (long long)entry.outofrange, entry.overlaps);
+        for (int bin = 0; bin < BOX_SIZE_BINS; bin++) fprintf(file, "\t%lld", (long long)entry.sizes[bin]);
+        fprintf(file, "\n");
+    }
+    if (fclose(file) != 0 || rename(temporary.c_str(), indexfile.c_str()) != 0)
+    {
+        printf("Cannot write dataset index %s\n", indexfile.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+void printStatistics(const std::vector<SequenceIndex> &entries)
+{
+    SequenceIndex total;
+    for (const SequenceIndex &entry : entries)
+    {
+        total.frames += entry.frames;
+        total.annotationfiles += entry.annotationfiles;
+        total.boxes += entry.boxes;
+        total.missing += entry.missing;
+        total.outofrange += entry.outofrange;
+        total.overlaps += entry.overlaps;
+        for (int bin = 0; bin < BOX_SIZE_BINS; bin++) total.sizes[bin] += entry.sizes[bin];
+    }
+    printf("Sequences:         %d\n", (int)entries.size());
+    printf("Frames:            %lld\n", (long long)total.frames);
+    printf("Annotation files:  %d\n", total.annotationfiles);
+    printf("Boxes:             %lld\n", (long long)total.boxes);
+    printf("Missing frames:    %lld\n", (long long)total.missing);
+    printf("IDs past the end:  %lld\n", (long long)total.outofrange);
+    printf("Box sizes (square root of the area):\n");
+    for (int bin = 0, limit = 16; bin < BOX_SIZE_BINS; bin++, limit *= 2)
+    {
+        if (bin == 0) printf("  below %d:  %lld\n", limit, (long long)total.sizes[bin]);
+        else if (bin == BOX_SIZE_BINS - 1) printf("  %d and above:  %lld\n", limit / 2, (long long)total.sizes[bin]);
+        else printf("  %d-%d:  %lld\n", limit / 2, limit, (long long)total.sizes[bin]);
+    }
+    for (const SequenceIndex &entry : entries)
+    {
+        if (entry.annotationfiles == 0) printf("No annotations in %s\n", entry.name.c_str());
+        if (entry.overlaps > 0) printf("Overlapping annotation ranges in %s:  %d\n", entry.name.c_str(), entry.overlaps);
+    }
+}
+
+}
+
+int indexDataset(const std::string &root, const std::string &indexfile, int threads)
+{
+    ScopedTimer timer;
+    DIR *dir = opendir(root.c_str());
+    if (!dir)
+    {
+        printf("%s directory does not exist or you have not right permissions\n", root.c_str());
+        return 1;
+    }
+    std::vector<SequenceIndex> entries;
+    while (struct dirent *file = readdir(dir))
+    {
+        std::string name = file->d_name;
+        if (name == "." || name == "..") continue;
+        struct stat st;
+        if (stat((root + name).c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+        entries.push_back(SequenceIndex());
+        entries.back().name = name;
+    }
+    closedir(dir);
+    std::sort(entries.begin(), entries.end(), [](const SequenceIndex &a, const SequenceIndex &b) { return a.name < b.name; });
+
+    std::unordered_map<std::string, SequenceIndex> previous = readIndex(indexfile);
+    std::atomic<int> next(0);
+    std::atomic<int> rescanned(0);
+    auto worker = [&]()
+    {
+        for (int i = next++; i < (int)entries.size(); i = next++)
+        {
+            SequenceIndex &entry = entries[i];
+            std::string directory = root + entry.name + "/";
+            std::vector<FileEntry> annotations;
+            if (!listSequence(directory, entry, annotations)) continue;
+            auto found = previous.find(entry.name);
+            if (found != previous.end() && found->second.signature == entry.signature && found->second.frames == entry.frames)
+            {
+                entry = found->second;
+                continue;
+            }
+            scanAnnotations(directory, annotations, entry);
+            rescanned++;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::max(1, threads); t++) workers.push_back(std::thread(worker));
+    for (std::thread &thread : workers) thread.join();
+
+    if (writeIndex(indexfile, entries) != 0) return 1;
+    printf("Indexed %d sequences (%d rescanned) of %s in %.2fs to %s\n", (int)entries.size(), rescanned.load(),
+        root.c_str(), timer.stop() / 1000.0, indexfile.c_str());
+    printStatistics(entries);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef DATASET_INDEX_H
+#define DATASET_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Dataset index - summary of every sequence directory in an ALOV dataset
+ * root, kept in a text file with one tab-separated line per sequence.
+ *
+ * A sequence is rescanned only if its signature - the modification time of
+ * the directory and the names, sizes and modification times of its
+ * annotation files - differs from the one in the index.
+ */
+
+/// Bins of the box size (square root of the area): below 16, then doubling up to 512 and above
+const int BOX_SIZE_BINS = 7;
+
+struct SequenceIndex
+{
+    std::string name;
+    uint64_t signature = 0;
+    int64_t frames = 0;
+    /// annotations*.ann and annotations*.annb files
+    int annotationfiles = 0;
+    int64_t boxes = 0;
+    /// Frame ids skipped inside the annotation files
+    int64_t missing = 0;
+    /// Frame ids past the last frame of the sequence
+    int64_t outofrange = 0;
+    /// Pairs of different annotations<first>-<last> ranges (last excluded) that overlap
+    int overlaps = 0;
+    int64_t sizes[BOX_SIZE_BINS] = {};
+};
+
+/**
+ * Scans the sequence directories of the dataset root on the given number of
+ * threads, reusing the entries of the unchanged sequences from the index
+ * file, writes the updated index and prints the aggregate statistics.
+ * Returns 0 on success.
+ */
+int indexDataset(const std::string &root, const std::string &indexfile, int threads);
+
+#endif
@@ -0,0 +1,293 @@
+#include "deploy-graph.h"
+#include "latency-stats.h"
+#ifdef USE_CAFFE
+#include <caffe/caffe.hpp>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+bool isNeeded(const std::set<std::string> &needed, const PrototxtNode &layer)
+{
+    for (const std::string &top : layer.strings("top"))
+    {
+        if (needed.count(top)) return true;
+    }
+    return false;
+}
+
+/// Renames the values of the fields with the given name in the layer
+void renameBlobs(PrototxtNode &layer, const std::string &field, const std::map<std::string, std::string> &aliases)
+{
+    for (PrototxtNode &child : layer.children)
+    {
+        if (child.message || child.name != field) continue;
+        std::map<std::string, std::string>::const_iterator alias = aliases.find(unquotePrototxt(child.value));
+        if (alias != aliases.end()) child.value = quotePrototxt(alias->second);
+    }
+}
+
+bool isLayer(const PrototxtNode &field)
+{
+    return field.message && field.name == "layer";
+}
+
+/// Number of network inputs - legacy input fields and tops of Input layers
+int countInputs(const PrototxtNode &network)
+{
+    int inputs = network.strings("input").size();
+    for (const PrototxtNode &field : network.children)
+    {
+        if (isLayer(field) && field.string("type") == "Input") inputs += field.strings("top").size();
+    }
+    return inputs;
+}
+
+}
+
+int trimDeployGraph(const PrototxtNode &network, const std::string &output, PrototxtNode &trimmed)
+{
+    std::vector<PrototxtNode> layers;
+    for (const PrototxtNode &field : network.children)
+    {
+        if (isLayer(field)) layers.push_back(field);
+    }
+
+    // number of layers reading each blob, a ReLU can overwrite its input only if it is the sole reader
+    std::map<std::string, int> readers;
+    for (const PrototxtNode &layer : layers)
+    {
+        for (const std::string &bottom : layer.strings("bottom")) readers[bottom]++;
+    }
+
+    // forward pass - skip dropouts and fold ReLUs in place, renaming the blobs read by the following layers
+    std::map<std::string, std::string> aliases;
+    std::vector<bool> keep(layers.size(), false);
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        PrototxtNode &layer = layers[i];
+        std::vector<std::string> originalbottoms = layer.strings("bottom");
+        renameBlobs(layer, "bottom", aliases);
+        std::vector<std::string> bottoms = layer.strings("bottom");
+        std::vector<std::string> tops = layer.strings("top");
+        for (const std::string &top : tops) aliases.erase(top);
+        keep[i] = true;
+
+        bool single = bottoms.size() == 1 && tops.size() == 1;
+        std::string type = layer.string("type");
+        if (single && type == "Dropout")
+        {
+            if (tops[0] != bottoms[0]) aliases[tops[0]] = bottoms[0];
+            keep[i] = false;
+        }
+        else if (single && type == "ReLU" && tops[0] != bottoms[0] && readers[originalbottoms[0]] == 1)
+        {
+            aliases[tops[0]] = bottoms[0];
+            std::map<std::string, std::string> inplace;
+            inplace[tops[0]] = bottoms[0];
+            renameBlobs(layer, "top", inplace);
+        }
+    }
+    std::string result = aliases.count(output) ? aliases[output] : output;
+
+    // backward pass - keep only the layers the output depends on
+    std::set<std::string> needed;
+    needed.insert(result);
+    bool produced = false;
+    for (int i = layers.size() - 1; i >= 0; i--)
+    {
+        if (!keep[i]) continue;
+        if (!isNeeded(needed, layers[i]))
+        {
+            keep[i] = false;
+            continue;
+        }
+        for (const std::string &top : layers[i].strings("top"))
+        {
+            if (top == result) produced = true;
+            needed.erase(top);
+        }
+        for (const std::string &bottom : layers[i].strings("bottom")) needed.insert(bottom);
+    }
+    if (!produced) return -1;
+
+    // blobs read by the kept layers, the unused inputs are removed
+    std::set<std::string> consumed;
+    consumed.insert(result);
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        if (!keep[i]) continue;
+        for (const std::string &bottom : layers[i].strings("bottom")) consumed.insert(bottom);
+    }
+
+    // legacy inputs are declared by the input fields, with 4 input_dim fields or an input_shape each
+    std::vector<std::string> inputs = network.strings("input");
+    trimmed = PrototxtNode();
+    trimmed.message = true;
+    int input = 0, dim = 0, shape = 0;
+    size_t layer = 0;
+    int removed = 0;
+    for (const PrototxtNode &field : network.children)
+    {
+        if (isLayer(field))
+        {
+            if (keep[layer]) trimmed.children.push_back(layers[layer]);
+            else removed++;
+            layer++;
+            continue;
+        }
+        // index of the input the field belongs to
+        int owner = -1;
+        if (field.name == "input") owner = input++;
+        else if (field.name == "input_dim") owner = dim++ / 4;
+        else if (field.name == "input_shape") owner = shape++;
+        bool unused = owner >= 0 && owner < (int)inputs.size() && !consumed.count(inputs[owner]);
+        if (!unused) trimmed.children.push_back(field);
+    }
+
+    // unused tops of Input layers are removed with their shapes, a single shape applies to all tops
+    for (PrototxtNode &field : trimmed.children)
+    {
+        if (!isLayer(field) || field.string("type") != "Input") continue;
+        std::vector<std::string> tops = field.strings("top");
+        PrototxtNode reduced;
+        std::vector<PrototxtNode> shapes;
+        for (const PrototxtNode &child : field.children)
+        {
+            if (child.name == "input_param")
+            {
+                for (const PrototxtNode &param : child.children)
+                {
+                    if (param.name == "shape") shapes.push_back(param);
+                }
+            }
+        }
+        int top = 0;
+        for (const PrototxtNode &child : field.children)
+        {
+            if (!child.message && child.name == "top")
+            {
+                if (consumed.count(tops[top])) reduced.children.push_back(child);
+                top++;
+            }
+            else if (child.name != "input_param")
+            {
+                reduced.children.push_back(child);
+            }
+        }
+        if (!shapes.empty())
+        {
+            PrototxtNode param;
+            param.name = "input_param";
+            param.message = true;
+            for (size_t t = 0; t < tops.size(); t++)
+            {
+                if (consumed.count(tops[t])) param.children.push_back(shapes[shapes.size() == 1 ? 0 : t]);
+            }
+            reduced.children.push_back(param);
+        }
+        field.children = reduced.children;
+    }
+    return removed;
+}
+
+std::string createDeployGraph(const std::string &prototxt, const std::string &output, int &inputs)
+{
+    PrototxtNode network;
+    if (readPrototxt(prototxt, network) != 0) return "";
+    for (const PrototxtNode &field : network.children)
+    {
+        if (field.message && field.name == "layers")
+        {
+            printf("The network %s uses the legacy V1 layers, upgrade it with Caffe's upgrade_net_proto_text\n", prototxt.c_str());
+            return "";
+        }
+    }
+    PrototxtNode trimmed;
+    int removed = trimDeployGraph(network, output, trimmed);
+    if (removed < 0)
+    {
+        printf("The network %s has no %s output\n", prototxt.c_str(), output.c_str());
+        return "";
+    }
+
+    const char *directory = getenv("TMPDIR");
+    std::string path = std::string(directory ? directory : "/tmp") + "/deploy-XXXXXX.prototxt";
+    std::vector<char> buffer(path.begin(), path.end());
+    buffer.push_back('\0');
+    int fd = mkstemps(buffer.data(), 9);
+    if (fd < 0)
+    {
+        printf("Unable to create the temporary file:  %s\n", path.c_str());
+        return "";
+    }
+    std::string text = writePrototxt(trimmed);
+    bool written = write(fd, text.data(), text.size()) == (ssize_t)text.size();
+    close(fd);
+    path = buffer.data();
+    if (!written)
+    {
+        printf("Unable to write the temporary file:  %s\n", path.c_str());
+        unlink(path.c_str());
+        return "";
+    }
+
+    inputs = countInputs(trimmed);
+    printf("Removed %d layers and %d inputs not needed for inference from %s\n",
+        removed, countInputs(network) - inputs, prototxt.c_str());
+    return path;
+}
+
+#ifdef USE_CAFFE
+int profileDeployGraph(const std::string &prototxt, const std::string &caffemodel, const std::string &output, int runs)
+{
+    int inputs;
+    std::string trimmed = createDeployGraph(prototxt, output, inputs);
+    if (trimmed.empty()) return 1;
+
+    const char *labels[2] = { "Full network", "Inference-only network" };
+    std::string paths[2] = { prototxt, trimmed };
+    for (int n = 0; n < 2; n++)
+    {
+        caffe::Net<float> network(paths[n], caffe::TEST);
+        network.CopyTrainedLayersFrom(caffemodel);
+
+        // in-place layers share their blobs, so every allocated blob is listed once
+        size_t activations = 0;
+        for (size_t b = 0; b < network.blobs().size(); b++) activations += network.blobs()[b]->count();
+        size_t parameters = 0;
+        for (size_t p = 0; p < network.params().size(); p++) parameters += network.params()[p]->count();
+
+        for (size_t i = 0; i < network.input_blobs().size(); i++)
+        {
+            caffe::Blob<float> *input = network.input_blobs()[i];
+            float *data = input->mutable_cpu_data();
+            for (int v = 0; v < input->count(); v++) data[v] = (v % 255) - 127.0f;
+        }
+
+        // the first pass allocates the buffers and is not measured
+        LatencyStats stats;
+        for (int run = 0; run <= runs; run++)
+        {
+            ScopedTimer timer;
+            network.Forward();
+            // reading the output waits for the GPU
+            network.blob_by_name(output)->cpu_data();
+            if (run > 0) stats.add(timer.stop());
+        }
+
+        printf("%s:  %d layers, %d blobs, activations %.1f MB, parameters %.1f MB\n",
+            labels[n], (int)network.layers().size(), (int)network.blobs().size(),
+            activations * sizeof(float) / 1048576.0, parameters * sizeof(float) / 1048576.0);
+        stats.print(std::string(labels[n]) + " forward");
+    }
+    unlink(trimmed.c_str());
+    return 0;
+}
+#endif
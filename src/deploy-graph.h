@@ -0,0 +1,41 @@
+#ifndef DEPLOY_GRAPH_H
+#define DEPLOY_GRAPH_H
+
+#include "prototxt.h"
+#include <string>
+
+/// Blob with the box estimate of the tracker network
+const char *const DEPLOY_OUTPUT = "fc8";
+
+/**
+ * Derives the inference-only network from the training definition.
+ *
+ * Keeps only the layers the output blob depends on, which removes the loss
+ * branch and its inputs (the bbox input of the tracker network). Dropout
+ * layers, identities at inference, are removed and ReLUs are made in-place
+ * when nothing else reads their inputs, so no extra activations are
+ * allocated for them. Returns the number of removed layers, or -1 if the
+ * output blob is not produced by the network.
+ */
+int trimDeployGraph(const PrototxtNode &network, const std::string &output, PrototxtNode &trimmed);
+
+/**
+ * Writes the inference-only version of the prototxt to a temporary file.
+ *
+ * Returns the path of the file, to be removed once the network is created,
+ * or an empty string on failure. The number of the remaining network inputs
+ * is stored in inputs.
+ */
+std::string createDeployGraph(const std::string &prototxt, const std::string &output, int &inputs);
+
+#ifdef USE_CAFFE
+/**
+ * Compares the full and the inference-only network in the current Caffe mode.
+ *
+ * Prints the blob memory and the forward latency of both networks over
+ * the given number of runs. Returns 0 on success.
+ */
+int profileDeployGraph(const std::string &prototxt, const std::string &caffemodel, const std::string &output, int runs);
+#endif
+
+#endif
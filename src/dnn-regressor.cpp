@@ -0,0 +1,74 @@
+#include "dnn-regressor.h"
+#include "deploy-graph.h"
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+
+#ifdef HAVE_OPENCV_DNN
+
+int DnnRegressor::load(const std::string &prototxt, const std::string &caffemodel)
+{
+    int inputs;
+    std::string deploy = createDeployGraph(prototxt, DEPLOY_OUTPUT, inputs);
+    if (deploy.empty()) return 1;
+    try
+    {
+        network = cv::dnn::readNetFromCaffe(deploy, caffemodel);
+    }
+    catch (const cv::Exception &error)
+    {
+        printf("Unable to load the network:  %s\n", error.what());
+    }
+    unlink(deploy.c_str());
+    if (network.empty()) return 1;
+    network.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    network.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    return 0;
+}
+
+void DnnRegressor::regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate)
+{
+    std::vector<BoundingBox> estimates;
+    regressBatch(std::vector<cv::Mat>(1, target), std::vector<cv::Mat>(1, search), estimates);
+    estimate = estimates[0];
+}
+
+void DnnRegressor::regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    cv::Size size(NETWORK_INPUT_SIZE, NETWORK_INPUT_SIZE);
+    cv::Scalar mean(NETWORK_MEAN[0], NETWORK_MEAN[1], NETWORK_MEAN[2]);
+    // the crops are resized and mean-subtracted like in the Caffe Regressor, keeping BGR
+    network.setInput(cv::dnn::blobFromImages(targets, 1.0, size, mean, false, false), "target");
+    network.setInput(cv::dnn::blobFromImages(searches, 1.0, size, mean, false, false), "image");
+    forward(targets.size(), estimates);
+}
+
+void DnnRegressor::regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    int shape[] = { (int)targets.size(), 3, NETWORK_INPUT_SIZE, NETWORK_INPUT_SIZE };
+    cv::Mat targetblob(4, shape, CV_32F);
+    cv::Mat searchblob(4, shape, CV_32F);
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        std::copy(targets[i], targets[i] + NETWORK_INPUT_VALUES, targetblob.ptr<float>() + i * NETWORK_INPUT_VALUES);
+        std::copy(searches[i], searches[i] + NETWORK_INPUT_VALUES, searchblob.ptr<float>() + i * NETWORK_INPUT_VALUES);
+    }
+    network.setInput(targetblob, "target");
+    network.setInput(searchblob, "image");
+    forward(targets.size(), estimates);
+}
+
+void DnnRegressor::forward(int count, std::vector<BoundingBox> &estimates)
+{
+    cv::Mat output = network.forward(DEPLOY_OUTPUT);
+    estimates.clear();
+    for (int i = 0; i < count; i++)
+    {
+        const float *values = output.ptr<float>() + 4 * i;
+        estimates.push_back(BoundingBox(std::vector<float>(values, values + 4)));
+    }
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef DNN_REGRESSOR_H
+#define DNN_REGRESSOR_H
+
+#include <opencv2/opencv_modules.hpp>
+
+#ifdef HAVE_OPENCV_DNN
+
+#include "box-regressor.h"
+#include <opencv2/dnn.hpp>
+#include <string>
+
+/**
+ * Runs the network with the OpenCV DNN module on the CPU.
+ *
+ * Loads the Caffe prototxt and caffemodel directly, so neither Caffe nor
+ * CUDA is needed. The number of threads follows cv::setNumThreads().
+ */
+class DnnRegressor : public BoxRegressor
+{
+public:
+    /**
+     * Loads the inference-only version of the network (OpenCV cannot
+     * create the loss layers of the training definition). Returns 0 on
+     * success.
+     */
+    int load(const std::string &prototxt, const std::string &caffemodel);
+
+    void regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate) override;
+
+    /// The inputs are stacked into blobs of the batch size, the network is reshaped to it
+    void regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+    /// The planar inputs are copied into the blobs as they are
+    void regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+private:
+    /// Runs the network on the input blobs set before
+    void forward(int count, std::vector<BoundingBox> &estimates);
+
+
+    cv::dnn::Net network;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+#include "flow-tracker.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+/// Smallest side of the box in the reduced image
+const int MIN_REDUCED_SIDE = 64;
+
+/// The points are sampled on a GRID_SIZE x GRID_SIZE grid inside the box
+const int GRID_SIZE = 10;
+
+/// Fewest points with a consistent forward-backward track that move the box
+const int MIN_POINTS = 4;
+
+/// Returns a new grayscale image, or the image if it already is one (the frames are never modified)
+cv::Mat grayscale(const cv::Mat &image)
+{
+    if (image.channels() == 1) return image;
+    cv::Mat gray;
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    return gray;
+}
+
+float median(std::vector<float> values)
+{
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+/**
+ * Moves the box (in the image coordinates) by the flow from previous to
+ * next, returns false if the flow is unreliable.
+ */
+bool propagate(const cv::Mat &previous, const cv::Mat &next, const BoundingBox &box, BoundingBox &moved)
+{
+    std::vector<cv::Point2f> points;
+    double width = box.x2_ - box.x1_;
+    double height = box.y2_ - box.y1_;
+    for (int y = 0; y < GRID_SIZE; y++)
+    {
+        for (int x = 0; x < GRID_SIZE; x++)
+        {
+            cv::Point2f point(box.x1_ + width * (x + 0.5) / GRID_SIZE, box.y1_ + height * (y + 0.5) / GRID_SIZE);
+            if (point.x >= 0 && point.y >= 0 && point.x < previous.cols && point.y < previous.rows) points.push_back(point);
+        }
+    }
+    if ((int)points.size() < MIN_POINTS) return false;
+
+    std::vector<cv::Point2f> forward, backward;
+    std::vector<uchar> forwardstatus, backwardstatus;
+    std::vector<float> errors;
+    cv::calcOpticalFlowPyrLK(previous, next, points, forward, forwardstatus, errors);
+    cv::calcOpticalFlowPyrLK(next, previous, forward, backward, backwardstatus, errors);
+
+    // only the points returning closer to the start than the median are trusted
+    std::vector<int> tracked;
+    std::vector<float> distances;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (!forwardstatus[i] || !backwardstatus[i]) continue;
+        tracked.push_back(i);
+        distances.push_back(cv::norm(backward[i] - points[i]));
+    }
+    if ((int)tracked.size() < MIN_POINTS) return false;
+    float threshold = median(distances);
+    std::vector<int> reliable;
+    for (size_t i = 0; i < tracked.size(); i++)
+    {
+        if (distances[i] <= threshold) reliable.push_back(tracked[i]);
+    }
+    if ((int)reliable.size() < MIN_POINTS) return false;
+
+    std::vector<float> dx, dy, ratios;
+    for (size_t i = 0; i < reliable.size(); i++)
+    {
+        int a = reliable[i];
+        dx.push_back(forward[a].x - points[a].x);
+        dy.push_back(forward[a].y - points[a].y);
+        for (size_t j = i + 1; j < reliable.size(); j++)
+        {
+            int b = reliable[j];
+            double before = cv::norm(points[a] - points[b]);
+            if (before > 0) ratios.push_back(cv::norm(forward[a] - forward[b]) / before);
+        }
+    }
+    double ratio = ratios.empty() ? 1.0 : median(ratios);
+    double centerx = (box.x1_ + box.x2_) / 2 + median(dx);
+    double centery = (box.y1_ + box.y2_) / 2 + median(dy);
+    moved.x1_ = centerx - width * ratio / 2;
+    moved.y1_ = centery - height * ratio / 2;
+    moved.x2_ = centerx + width * ratio / 2;
+    moved.y2_ = centery + height * ratio / 2;
+    return true;
+}
+
+}
+
+void FlowTracker::init(const cv::Mat &image, const BoundingBox &bbox, int scale)
+{
+    current.data = grayscale(image);
+    current.box = bbox;
+}
+
+void FlowTracker::track(const cv::Mat &image, BoundingBox &bbox, int scale)
+{
+    cv::Mat next = grayscale(image);
+    // the previous frame could be decoded at another scale
+    cv::Mat previous = current.data;
+    if (previous.size() != next.size()) cv::resize(previous, previous, next.size(), 0, 0, cv::INTER_AREA);
+
+    BoundingBox moved;
+    if (propagate(previous, next, scaleBox(current.box, 1.0 / scale), moved)) bbox = scaleBox(moved, scale);
+    else bbox = current.box;
+    current.data = next;
+    current.box = bbox;
+}
+
+int FlowTracker::reducedScale(int maxscale) const
+{
+    return reducedScale(current.box, maxscale);
+}
+
+int FlowTracker::reducedScale(const BoundingBox &bbox, int maxscale)
+{
+    double side = std::min(bbox.x2_ - bbox.x1_, bbox.y2_ - bbox.y1_);
+    maxscale = std::min(maxscale, MAX_REDUCED_SCALE);
+    int scale = 1;
+    while (scale < maxscale && side / (2 * scale) >= MIN_REDUCED_SIDE) scale *= 2;
+    return scale;
+}
+
+std::string FlowBackend::name() const
+{
+    return "flow";
+}
+
+std::unique_ptr<ObjectTracker> FlowBackend::createTracker()
+{
+    return std::unique_ptr<ObjectTracker>(new FlowTracker());
+}
+
+int FlowBackend::reducedScale(const BoundingBox &bbox, int maxscale) const
+{
+    return FlowTracker::reducedScale(bbox, maxscale);
+}
+
+void FlowBackend::trackObjects(const std::vector<ObjectTracker *> &trackers, const cv::Mat &image,
+    std::vector<BoundingBox> &bboxes, int scale)
+{
+    // the objects share the grayscale frame
+    cv::Mat gray = grayscale(image);
+    bboxes.resize(trackers.size());
+    // the trackers are created by this backend
+    for (size_t i = 0; i < trackers.size(); i++) static_cast<FlowTracker *>(trackers[i])->track(gray, bboxes[i], scale);
+}
@@ -0,0 +1,51 @@
+#ifndef FLOW_TRACKER_H
+#define FLOW_TRACKER_H
+
+#include "tracker-backend.h"
+
+/**
+ * Propagates the box with pyramidal Lucas-Kanade optical flow (the Median
+ * Flow method).
+ *
+ * A grid of points inside the box is tracked to the next frame and back,
+ * the points whose backward track ends furthest from the start are
+ * dropped, and the box is moved by the median displacement of the rest and
+ * resized by the median change of their pairwise distances. If too few
+ * points are left, the box stays in place.
+ *
+ * Much cheaper than GOTURN and without a network, suitable for easy
+ * footage - static camera, slow objects without occlusions. The state data
+ * is the grayscale previous frame.
+ */
+class FlowTracker : public ObjectTracker
+{
+public:
+    void init(const cv::Mat &image, const BoundingBox &bbox, int scale = 1) override;
+
+    /// Tracks the box to the next image downscaled by scale, bbox is set to the new location
+    void track(const cv::Mat &image, BoundingBox &bbox, int scale = 1);
+
+    /// The box stays large enough to hold the flow windows
+    int reducedScale(int maxscale) const override;
+
+    /// Returns the largest scale the image can be downscaled by to start tracking the box
+    static int reducedScale(const BoundingBox &bbox, int maxscale);
+};
+
+/**
+ * Tracker backend propagating the boxes with optical flow, the objects are
+ * tracked one by one.
+ */
+class FlowBackend : public TrackerBackend
+{
+public:
+    std::string name() const override;
+    std::unique_ptr<ObjectTracker> createTracker() override;
+    int reducedScale(const BoundingBox &bbox, int maxscale) const override;
+
+protected:
+    void trackObjects(const std::vector<ObjectTracker *> &trackers, const cv::Mat &image,
+        std::vector<BoundingBox> &bboxes, int scale) override;
+};
+
+#endif
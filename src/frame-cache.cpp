@@ -0,0 +1,202 @@
+#include "frame-cache.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+FrameCache::FrameCache(std::unique_ptr<FrameSource> source, size_t capacity, int readahead)
+    : source(std::move(source)),
+    capacity(capacity),
+    readahead(readahead),
+    bytes(0),
+    stats(),
+    prefetchframe(0),
+    prefetchdirection(1),
+    prefetchpending(false),
+    stopping(false)
+{
+    if (readahead > 0) prefetcher = std::thread(&FrameCache::prefetchLoop, this);
+}
+
+FrameCache::~FrameCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(cachemutex);
+        stopping = true;
+        prefetchcond.notify_all();
+    }
+    if (prefetcher.joinable()) prefetcher.join();
+}
+
+int FrameCache::size() const
+{
+    return source->size();
+}
+
+bool FrameCache::lookup(int index, cv::Mat &image, bool count)
+{
+    std::lock_guard<std::mutex> lock(cachemutex);
+    auto it = entries.find(index);
+    if (it == entries.end())
+    {
+        if (count) stats.misses++;
+        return false;
+    }
+    if (count) stats.hits++;
+    recent.splice(recent.begin(), recent, it->second.position);
+    image = it->second.image;
+    return true;
+}
+
+void FrameCache::insert(int index, const cv::Mat &image)
+{
+    std::lock_guard<std::mutex> lock(cachemutex);
+    if (image.empty() || entries.count(index) != 0) return;
+    recent.push_front(index);
+    Entry entry;
+    entry.image = image;
+    entry.position = recent.begin();
+    entries[index] = entry;
+    bytes += image.total() * image.elemSize();
+    // always keep the most recent frame, even if it alone exceeds the capacity
+    while (bytes > capacity && recent.size() > 1)
+    {
+        auto last = entries.find(recent.back());
+        bytes -= last->second.image.total() * last->second.image.elemSize();
+        entries.erase(last);
+        recent.pop_back();
+    }
+}
+
+std::unique_lock<std::mutex> FrameCache::lockSource()
+{
+    if (source->threadSafe()) return std::unique_lock<std::mutex>();
+    return std::unique_lock<std::mutex>(sourcemutex);
+}
+
+cv::Mat FrameCache::decode(int index, bool prefetched)
+{
+    std::unique_lock<std::mutex> lock = lockSource();
+    // the frame could have been decoded while waiting for the source
+    cv::Mat image;
+    if (lookup(index, image, false)) return image;
+
+    auto start = std::chrono::steady_clock::now();
+    image = source->read(index);
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        std::lock_guard<std::mutex> statslock(cachemutex);
+        stats.decoded++;
+        if (prefetched) stats.prefetched++;
+        stats.decodetime += elapsed;
+        stats.maxdecodetime = std::max(stats.maxdecodetime, elapsed);
+    }
+    insert(index, image);
+    return image;
+}
+
+cv::Mat FrameCache::read(int index)
+{
+    cv::Mat image;
+    if (lookup(index, image, true)) return image;
+    return decode(index, false);
+}
+
+bool FrameCache::readEncoded(int index, std::vector<uchar> &data)
+{
+    if (!source->storesEncoded())
+    {
+        // only the decoding needs the source, the exports encode in parallel
+        cv::Mat image = read(index);
+        if (image.empty()) return false;
+        return cv::imencode(".jpg", image, data);
+    }
+    std::unique_lock<std::mutex> lock = lockSource();
+    return source->readEncoded(index, data);
+}
+
+bool FrameCache::storesEncoded() const
+{
+    return source->storesEncoded();
+}
+
+cv::Mat FrameCache::readReduced(int index, int scale)
+{
+    if (scale <= 1) return read(index);
+    cv::Mat image;
+    if (lookup(index, image, false)) return downscaleFrame(image, scale);
+    std::unique_lock<std::mutex> lock = lockSource();
+    return source->readReduced(index, scale);
+}
+
+std::string FrameCache::filePath(int index) const
+{
+    return source->filePath(index);
+}
+
+std::string FrameCache::name(int index) const
+{
+    return source->name(index);
+}
+
+void FrameCache::prefetch(int frame, int direction)
+{
+    std::lock_guard<std::mutex> lock(cachemutex);
+    prefetchframe = frame;
+    prefetchdirection = direction < 0 ? -1 : 1;
+    prefetchpending = true;
+    prefetchcond.notify_all();
+}
+
+void FrameCache::prefetchLoop()
+{
+    while (true)
+    {
+        int frame, direction;
+        {
+            std::unique_lock<std::mutex> lock(cachemutex);
+            prefetchcond.wait(lock, [this] { return stopping || prefetchpending; });
+            if (stopping) return;
+            frame = prefetchframe;
+            direction = prefetchdirection;
+            prefetchpending = false;
+        }
+        for (int i = 1; i <= readahead; i++)
+        {
+            int index = frame + i * direction;
+            if (index < 0 || index >= size()) break;
+            {
+                // stop reading ahead of the stale position
+                std::lock_guard<std::mutex> lock(cachemutex);
+                if (stopping || prefetchpending) break;
+                if (entries.count(index) != 0) continue;
+            }
+            decode(index, true);
+        }
+    }
+}
+
+FrameCacheStatistics FrameCache::statistics() const
+{
+    std::lock_guard<std::mutex> lock(cachemutex);
+    FrameCacheStatistics result = stats;
+    result.bytes = bytes;
+    result.frames = entries.size();
+    return result;
+}
+
+void FrameCache::printStatistics() const
+{
+    FrameCacheStatistics s = statistics();
+    uint64_t requests = s.hits + s.misses;
+    printf("Frame cache:  %d frames (%.1f MB), hit rate %.1f%% (%llu/%llu), %llu frames prefetched\n",
+        s.frames, s.bytes / (1024.0 * 1024.0),
+        requests > 0 ? 100.0 * s.hits / requests : 0.0,
+        (unsigned long long)s.hits, (unsigned long long)requests,
+        (unsigned long long)s.prefetched);
+    printf("Frame decoding:  %llu frames, average %.2fms, max %.2fms\n",
+        (unsigned long long)s.decoded,
+        s.decoded > 0 ? s.decodetime / s.decoded : 0.0,
+        s.maxdecodetime);
+}
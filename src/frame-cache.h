@@ -0,0 +1,99 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include "frame-source.h"
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+struct FrameCacheStatistics
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t prefetched;
+    uint64_t decoded;
+    double decodetime;
+    double maxdecodetime;
+    size_t bytes;
+    int frames;
+};
+
+/**
+ * Bounded-memory LRU cache of decoded frames with read-ahead.
+ *
+ * The cache wraps another frame source and can be used from multiple
+ * threads - the access to a source that is not thread-safe is serialized,
+ * the others decode in parallel. The frames of the sources without stored
+ * encoded frames are encoded outside of the lock.
+ *
+ * A background thread decodes the frames ahead of the last position passed
+ * to prefetch(), in the given direction, so that playing and stepping
+ * through the frames does not wait for the decoder.
+ */
+class FrameCache : public FrameSource
+{
+public:
+    FrameCache(std::unique_ptr<FrameSource> source, size_t capacity, int readahead);
+    ~FrameCache();
+
+    int size() const override;
+    cv::Mat read(int index) override;
+    bool readEncoded(int index, std::vector<uchar> &data) override;
+    bool storesEncoded() const override;
+    bool threadSafe() const override { return true; }
+
+    /// Resizes the cached full frame if there is one, the reduced frames are not cached
+    cv::Mat readReduced(int index, int scale) override;
+
+    std::string filePath(int index) const override;
+    std::string name(int index) const override;
+
+    /**
+     * Schedules decoding of the frames following the frame in the direction
+     * (1 - forward, -1 - backward).
+     */
+    void prefetch(int frame, int direction);
+
+    FrameCacheStatistics statistics() const;
+
+    void printStatistics() const;
+
+private:
+    struct Entry
+    {
+        cv::Mat image;
+        std::list<int>::iterator position;
+    };
+
+    bool lookup(int index, cv::Mat &image, bool count);
+    cv::Mat decode(int index, bool prefetched);
+    void insert(int index, const cv::Mat &image);
+    void prefetchLoop();
+    /// Locks sourcemutex unless the source is thread-safe
+    std::unique_lock<std::mutex> lockSource();
+
+    std::unique_ptr<FrameSource> source;
+    const size_t capacity;
+    const int readahead;
+
+    mutable std::mutex cachemutex;
+    std::list<int> recent;
+    std::unordered_map<int, Entry> entries;
+    size_t bytes;
+    FrameCacheStatistics stats;
+
+    /// Serializes the reads of a source that is not thread-safe
+    std::mutex sourcemutex;
+
+    std::condition_variable prefetchcond;
+    int prefetchframe;
+    int prefetchdirection;
+    bool prefetchpending;
+    bool stopping;
+    std::thread prefetcher;
+};
+
+#endif
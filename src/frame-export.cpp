@@ -0,0 +1,194 @@
+#include "frame-export.h"
+#include "latency-stats.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <iomanip>
+#include <sstream>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace
+{
+
+enum ExportMethod
+{
+    LINKED,
+    CLONED,
+    KERNEL_COPIED,
+    COPIED,
+    WRITTEN,
+    ENCODED,
+    METHODS
+};
+
+const char *METHOD_NAMES[METHODS] = { "hard linked", "cloned", "copied in the kernel", "copied", "written", "re-encoded" };
+
+/// Copies the rest of the file with read and write, returns false on failure
+bool copyBytes(int in, int out)
+{
+    std::vector<char> buffer(1 << 20);
+    while (true)
+    {
+        ssize_t count = read(in, buffer.data(), buffer.size());
+        if (count == 0) return true;
+        if (count < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        for (ssize_t written = 0; written < count;)
+        {
+            ssize_t result = write(out, buffer.data() + written, count - written);
+            if (result < 0 && errno != EINTR) return false;
+            if (result > 0) written += result;
+        }
+    }
+}
+
+/**
+ * Copies the file with the cheapest method the file system supports, the
+ * destination is replaced. Returns the method, or METHODS on failure.
+ */
+ExportMethod copyFile(const std::string &from, const std::string &to)
+{
+    // saving into the frames directory, the frame is already there
+    struct stat source, destination;
+    if (stat(from.c_str(), &source) == 0 && stat(to.c_str(), &destination) == 0 &&
+        source.st_dev == destination.st_dev && source.st_ino == destination.st_ino) return LINKED;
+    // an earlier export could be a hard link to the source, it must not be written over
+    if (unlink(to.c_str()) != 0 && errno != ENOENT) return METHODS;
+    if (link(from.c_str(), to.c_str()) == 0) return LINKED;
+
+    int in = open(from.c_str(), O_RDONLY);
+    if (in < 0) return METHODS;
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+    {
+        close(in);
+        return METHODS;
+    }
+    ExportMethod method = METHODS;
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0) method = CLONED;
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    if (method == METHODS)
+    {
+        struct stat status;
+        if (fstat(in, &status) == 0)
+        {
+            off_t remaining = status.st_size;
+            while (remaining > 0)
+            {
+                ssize_t copied = copy_file_range(in, NULL, out, NULL, remaining, 0);
+                if (copied <= 0) break;
+                remaining -= copied;
+            }
+            if (remaining == 0) method = KERNEL_COPIED;
+        }
+        // the file system does not support it, the bytes copied so far are skipped by the plain copy
+    }
+#endif
+    if (method == METHODS && copyBytes(in, out)) method = COPIED;
+    close(in);
+    if (close(out) != 0) method = METHODS;
+    return method;
+}
+
+bool writeFile(const std::string &path, const std::vector<uchar> &data)
+{
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) return false;
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
+
+/// Exports the frame to the path, returns the method or METHODS on failure
+ExportMethod exportFrame(FrameSource &source, int index, const std::string &path, const ExportOptions &options)
+{
+    std::vector<uchar> data;
+    if (options.reencode())
+    {
+        cv::Mat image = source.read(index);
+        if (image.empty()) return METHODS;
+        cv::Size size = exportedSize(image.size(), options);
+        if (size != image.size())
+        {
+            cv::Mat resized;
+            cv::resize(image, resized, size, 0, 0, cv::INTER_AREA);
+            image = resized;
+        }
+        std::vector<int> parameters;
+        if (options.quality > 0) parameters = { cv::IMWRITE_JPEG_QUALITY, options.quality };
+        if (!cv::imencode(".jpg", image, data, parameters)) return METHODS;
+        return writeFile(path, data) ? ENCODED : METHODS;
+    }
+    std::string file = source.filePath(index);
+    if (file != "") return copyFile(file, path);
+    if (!source.readEncoded(index, data)) return METHODS;
+    return writeFile(path, data) ? WRITTEN : METHODS;
+}
+
+}
+
+bool ExportOptions::reencode() const
+{
+    return width > 0 || height > 0 || quality > 0;
+}
+
+cv::Size exportedSize(const cv::Size &size, const ExportOptions &options)
+{
+    if (options.width > 0 && options.height > 0) return cv::Size(options.width, options.height);
+    if (options.width > 0) return cv::Size(options.width, std::max(1, (int)std::lround((double)size.height * options.width / size.width)));
+    if (options.height > 0) return cv::Size(std::max(1, (int)std::lround((double)size.width * options.height / size.height)), options.height);
+    return size;
+}
+
+int exportFrames(FrameSource &source, int first, int last, const std::string &directory, const ExportOptions &options)
+{
+    ScopedTimer timer;
+    std::atomic<int> next(first);
+    std::atomic<bool> failed(false);
+    std::vector<std::atomic<int>> counts(METHODS);
+    auto worker = [&]()
+    {
+        for (int i = next++; i < last && !failed; i = next++)
+        {
+            std::ostringstream path;
+            path << directory << std::setfill('0') << std::setw(8) << i - first + 1 << ".jpg";
+            ExportMethod method = exportFrame(source, i, path.str(), options);
+            if (method == METHODS)
+            {
+                printf("Failed to export frame %s to %s\n", source.name(i).c_str(), path.str().c_str());
+                failed = true;
+                return;
+            }
+            counts[method]++;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < std::max(1, options.threads); t++) threads.push_back(std::thread(worker));
+    for (std::thread &thread : threads) thread.join();
+    if (failed) return 1;
+
+    printf("Exported %d frames in %.2fs:", last - first, timer.stop() / 1000.0);
+    for (int method = 0; method < METHODS; method++)
+    {
+        if (counts[method] > 0) printf(" %d %s", counts[method].load(), METHOD_NAMES[method]);
+    }
+    printf("\n");
+    return 0;
+}
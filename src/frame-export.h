@@ -0,0 +1,43 @@
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+#include "frame-source.h"
+#include <opencv2/core/core.hpp>
+#include <string>
+
+/**
+ * Format of the exported frames. By default the frames are exported as
+ * they are encoded in the source, setting the size or the quality
+ * re-encodes them.
+ */
+struct ExportOptions
+{
+    /// Size of the exported frames, 0 keeps the dimension (or scales it with the other one, keeping the aspect ratio)
+    int width = 0;
+    int height = 0;
+    /// JPEG quality (1-100) of the re-encoded frames, 0 keeps the OpenCV default
+    int quality = 0;
+    int threads = 1;
+
+    bool reencode() const;
+};
+
+/// Returns the size the frames of the given size are exported at
+cv::Size exportedSize(const cv::Size &size, const ExportOptions &options);
+
+/**
+ * Writes the frames [first, last) of the source as <n>.jpg files (n counted
+ * from 1, zero-padded to 8 digits) to the directory, on options.threads
+ * threads. The source must be safe to read from multiple threads.
+ *
+ * Without re-encoding, a frame stored in its own file is hard linked,
+ * cloned (FICLONE), copied in the kernel (copy_file_range) or byte-copied,
+ * whichever the file system supports first. The other frames are written
+ * from their encoded bytes. The existing files are replaced, never written
+ * over, so the frames linked by an earlier export are not modified.
+ *
+ * Returns 0 on success.
+ */
+int exportFrames(FrameSource &source, int first, int last, const std::string &directory, const ExportOptions &options);
+
+#endif
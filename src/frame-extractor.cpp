@@ -0,0 +1,176 @@
+#include "frame-extractor.h"
+#include "bounded-queue.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+
+struct DecodedFrame
+{
+    int index;
+    cv::Mat image;
+};
+
+struct EncodedFrame
+{
+    int index;
+    std::vector<uchar> data;
+};
+
+}
+
+FrameExtractor::FrameExtractor(const std::string &videoname, FrameSink &sink, cv::Size framesize, int threads)
+    : videoname(videoname), sink(sink), framesize(framesize)
+{
+    if (threads < 2) threads = 2;
+    // resizing is much cheaper than JPEG encoding, give most of the threads to the encoders
+    resizethreads = std::max(1, threads / 4);
+    encodethreads = std::max(1, threads - resizethreads);
+}
+
+int FrameExtractor::run()
+{
+    cv::VideoCapture cap(videoname, cv::CAP_FFMPEG);
+
+    if (!cap.isOpened())
+    {
+        printf("Error opening video stream or file\n");
+        return -1;
+    }
+
+    printf("Extracting frames with %d resize and %d encode workers\n", resizethreads, encodethreads);
+
+    const size_t queuecapacity = 2 * (resizethreads + encodethreads);
+    // enough frames in flight to fill both queues and keep every worker busy
+    const int reorderwindow = 2 * queuecapacity + resizethreads + encodethreads;
+
+    BoundedQueue<DecodedFrame> decoded(queuecapacity);
+    BoundedQueue<DecodedFrame> resized(queuecapacity);
+
+    std::mutex writermutex;
+    std::condition_variable writercond;
+    std::map<int, std::vector<uchar>> pending;
+    int nextwrite = 0;
+    int activeencoders = encodethreads;
+    std::atomic<int> activeresizers(resizethreads);
+    std::atomic<bool> failed(false);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread decoder([&]()
+    {
+        int index = 0;
+        while (!failed)
+        {
+            DecodedFrame item;
+            cap >> item.image;
+            if (item.image.empty()) break;
+            item.index = index++;
+            {
+                // the memory is bounded here, before the frames leave the ordered stage - a worker
+                // waiting while holding a frame could block the frame the writer needs next
+                std::unique_lock<std::mutex> lock(writermutex);
+                writercond.wait(lock, [&] { return failed || item.index < nextwrite + reorderwindow; });
+            }
+            if (failed) break;
+            if (!decoded.push(std::move(item))) break;
+        }
+        decoded.close();
+    });
+
+    std::vector<std::thread> resizers;
+    for (int t = 0; t < resizethreads; t++)
+    {
+        resizers.emplace_back([&]()
+        {
+            DecodedFrame item;
+            while (decoded.pop(item))
+            {
+                cv::resize(item.image, item.image, framesize);
+                if (!resized.push(std::move(item))) break;
+            }
+            if (--activeresizers == 0) resized.close();
+        });
+    }
+
+    std::vector<std::thread> encoders;
+    for (int t = 0; t < encodethreads; t++)
+    {
+        encoders.emplace_back([&]()
+        {
+            DecodedFrame item;
+            while (resized.pop(item))
+            {
+                EncodedFrame encoded;
+                encoded.index = item.index;
+                if (!cv::imencode(".jpg", item.image, encoded.data) || encoded.data.empty())
+                {
+                    printf("Failed to encode frame %d\n", item.index);
+                    failed = true;
+                    decoded.close();
+                    resized.close();
+                    std::lock_guard<std::mutex> lock(writermutex);
+                    writercond.notify_all();
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(writermutex);
+                if (failed) break;
+                pending[encoded.index] = std::move(encoded.data);
+                writercond.notify_all();
+            }
+            std::lock_guard<std::mutex> lock(writermutex);
+            activeencoders--;
+            writercond.notify_all();
+        });
+    }
+
+    std::thread writer([&]()
+    {
+        while (true)
+        {
+            std::vector<uchar> data;
+            {
+                std::unique_lock<std::mutex> lock(writermutex);
+                writercond.wait(lock, [&] { return failed || pending.count(nextwrite) != 0 || activeencoders == 0; });
+                auto it = pending.find(nextwrite);
+                if (failed || it == pending.end()) break;
+                data = std::move(it->second);
+                pending.erase(it);
+            }
+            if (sink.append(data.data(), data.size()) != 0)
+            {
+                failed = true;
+                decoded.close();
+                resized.close();
+                std::lock_guard<std::mutex> lock(writermutex);
+                writercond.notify_all();
+                break;
+            }
+            std::lock_guard<std::mutex> lock(writermutex);
+            nextwrite++;
+            if (nextwrite % 100 == 0) printf("Frame:  %d\n", nextwrite);
+            writercond.notify_all();
+        }
+    });
+
+    decoder.join();
+    for (auto &thread : resizers) thread.join();
+    for (auto &thread : encoders) thread.join();
+    writer.join();
+    cap.release();
+
+    if (failed) return 1;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Extracted %d frames in %.2fs (%.2f frames/s)\n", nextwrite, elapsed, elapsed > 0 ? nextwrite / elapsed : 0.0);
+    return 0;
+}
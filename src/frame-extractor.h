@@ -0,0 +1,41 @@
+#ifndef FRAME_EXTRACTOR_H
+#define FRAME_EXTRACTOR_H
+
+#include "frame-source.h"
+#include <opencv2/core/core.hpp>
+#include <string>
+
+/**
+ * Converts a video file into a sequence of JPEG frames.
+ *
+ * The work is split into stages connected with bounded queues:
+ *
+ * - a single decoding thread reading frames from the video,
+ * - a pool of workers resizing the frames to the requested size,
+ * - a pool of workers encoding the frames to JPEG,
+ * - a writer thread appending encoded frames in order to the frame sink.
+ *
+ * The bounded queues and the reordering window limit the number of frames
+ * held in memory regardless of the video length.
+ */
+class FrameExtractor
+{
+public:
+    FrameExtractor(const std::string &videoname, FrameSink &sink, cv::Size framesize, int threads);
+
+    /**
+     * Runs the extraction.
+     *
+     * Returns 0 on success, non-zero otherwise.
+     */
+    int run();
+
+private:
+    std::string videoname;
+    FrameSink &sink;
+    cv::Size framesize;
+    int resizethreads;
+    int encodethreads;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "frame-pack.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char *FRAME_PACK_DATA = "frames.pack";
+const char *FRAME_PACK_INDEX = "frames.idx";
+
+static const char FRAME_PACK_MAGIC[8] = {'F', 'R', 'M', 'P', 'A', 'C', 'K', '\0'};
+static const uint32_t FRAME_PACK_VERSION = 1;
+
+static_assert(sizeof(FramePackHeader) == 16, "Unexpected frame pack header size");
+static_assert(sizeof(FramePackEntry) == 16, "Unexpected frame pack entry size");
+
+static bool writeAll(int fd, const void *buffer, size_t size, off_t offset)
+{
+    const char *ptr = static_cast<const char *>(buffer);
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, ptr, size, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        ptr += written;
+        offset += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool validHeader(const FramePackHeader &header)
+{
+    return memcmp(header.magic, FRAME_PACK_MAGIC, sizeof(FRAME_PACK_MAGIC)) == 0 &&
+        header.version == FRAME_PACK_VERSION &&
+        header.entrysize == sizeof(FramePackEntry);
+}
+
+bool hasFramePack(const std::string &directory)
+{
+    struct stat st;
+    return stat((directory + FRAME_PACK_INDEX).c_str(), &st) == 0 &&
+        stat((directory + FRAME_PACK_DATA).c_str(), &st) == 0;
+}
+
+FramePackWriter::FramePackWriter()
+    : datafd(-1), indexfd(-1), dataend(0), indexend(0)
+{
+}
+
+FramePackWriter::~FramePackWriter()
+{
+    close();
+}
+
+int FramePackWriter::open(const std::string &directory)
+{
+    close();
+    datafd = ::open((directory + FRAME_PACK_DATA).c_str(), O_RDWR | O_CREAT, 0644);
+    indexfd = ::open((directory + FRAME_PACK_INDEX).c_str(), O_RDWR | O_CREAT, 0644);
+    if (datafd < 0 || indexfd < 0)
+    {
+        printf("Cannot open frame pack in %s\n", directory.c_str());
+        close();
+        return 1;
+    }
+
+    struct stat st, datast;
+    if (fstat(indexfd, &st) != 0 || fstat(datafd, &datast) != 0)
+    {
+        printf("Cannot open frame pack in %s\n", directory.c_str());
+        close();
+        return 1;
+    }
+    if (st.st_size == 0)
+    {
+        FramePackHeader header;
+        memcpy(header.magic, FRAME_PACK_MAGIC, sizeof(header.magic));
+        header.version = FRAME_PACK_VERSION;
+        header.entrysize = sizeof(FramePackEntry);
+        if (!writeAll(indexfd, &header, sizeof(header), 0))
+        {
+            close();
+            return 1;
+        }
+        st.st_size = sizeof(header);
+    }
+    else
+    {
+        FramePackHeader header;
+        if (pread(indexfd, &header, sizeof(header), 0) != sizeof(header) || !validHeader(header))
+        {
+            printf("%s%s is not a valid frame pack index\n", directory.c_str(), FRAME_PACK_INDEX);
+            close();
+            return 1;
+        }
+    }
+
+    // drop partially written entries and frames left by an interrupted append, and the
+    // entries of frames missing in the data file, which would be grown with zeros otherwise
+    off_t entries = (st.st_size - sizeof(FramePackHeader)) / sizeof(FramePackEntry);
+    dataend = 0;
+    for (; entries > 0; entries--)
+    {
+        FramePackEntry last;
+        off_t position = sizeof(FramePackHeader) + (entries - 1) * sizeof(FramePackEntry);
+        if (pread(indexfd, &last, sizeof(last), position) != sizeof(last))
+        {
+            close();
+            return 1;
+        }
+        if (last.offset + last.size <= (uint64_t)datast.st_size)
+        {
+            dataend = last.offset + last.size;
+            break;
+        }
+    }
+    indexend = sizeof(FramePackHeader) + entries * sizeof(FramePackEntry);
+    if (ftruncate(indexfd, indexend) != 0 || ftruncate(datafd, dataend) != 0)
+    {
+        close();
+        return 1;
+    }
+    return 0;
+}
+
+int FramePackWriter::append(const uchar *data, size_t size)
+{
+    if (datafd < 0 || indexfd < 0) return 1;
+    if (!writeAll(datafd, data, size, dataend))
+    {
+        printf("Failed to append frame to the frame pack\n");
+        return 1;
+    }
+    FramePackEntry entry;
+    entry.offset = dataend;
+    entry.size = size;
+    entry.reserved = 0;
+    if (!writeAll(indexfd, &entry, sizeof(entry), indexend))
+    {
+        printf("Failed to append frame to the frame pack index\n");
+        return 1;
+    }
+    dataend += size;
+    indexend += sizeof(entry);
+    return 0;
+}
+
+void FramePackWriter::close()
+{
+    if (datafd >= 0) ::close(datafd);
+    if (indexfd >= 0) ::close(indexfd);
+    datafd = -1;
+    indexfd = -1;
+}
+
+FramePackSource::FramePackSource()
+    : data(nullptr), datasize(0), index(nullptr), indexsize(0), count(0)
+{
+}
+
+FramePackSource::~FramePackSource()
+{
+    unmap();
+}
+
+static const uchar *mapFile(const std::string &path, size_t &size)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        size = 0;
+        return nullptr;
+    }
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) return nullptr;
+    size = st.st_size;
+    return static_cast<const uchar *>(ptr);
+}
+
+int FramePackSource::open(const std::string &directory)
+{
+    unmap();
+    this->directory = directory;
+    index = mapFile(directory + FRAME_PACK_INDEX, indexsize);
+    if (!index || indexsize < sizeof(FramePackHeader) ||
+        !validHeader(*reinterpret_cast<const FramePackHeader *>(index)))
+    {
+        printf("%s%s is not a valid frame pack index\n", directory.c_str(), FRAME_PACK_INDEX);
+        unmap();
+        return 1;
+    }
+    data = mapFile(directory + FRAME_PACK_DATA, datasize);
+
+    // only the frames fully present in the data file are visible
+    const FramePackEntry *entries = reinterpret_cast<const FramePackEntry *>(index + sizeof(FramePackHeader));
+    int entrycount = (indexsize - sizeof(FramePackHeader)) / sizeof(FramePackEntry);
+    count = 0;
+    while (count < entrycount && entries[count].offset + entries[count].size <= datasize) count++;
+    return 0;
+}
+
+int FramePackSource::size() const
+{
+    return count;
+}
+
+const uchar *FramePackSource::frameData(int frame, size_t &size) const
+{
+    const FramePackEntry &entry = reinterpret_cast<const FramePackEntry *>(index + sizeof(FramePackHeader))[frame];
+    size = entry.size;
+    return data + entry.offset;
+}
+
+cv::Mat FramePackSource::read(int frame)
+{
+    size_t size;
+    const uchar *ptr = frameData(frame, size);
+    return cv::imdecode(cv::Mat(1, size, CV_8UC1, const_cast<uchar *>(ptr)), cv::IMREAD_COLOR);
+}
+
+cv::Mat FramePackSource::readReduced(int frame, int scale)
+{
+    size_t size;
+    const uchar *ptr = frameData(frame, size);
+    return cv::imdecode(cv::Mat(1, size, CV_8UC1, const_cast<uchar *>(ptr)), reducedReadFlags(scale));
+}
+
+bool FramePackSource::readEncoded(int frame, std::vector<uchar> &encoded)
+{
+    size_t size;
+    const uchar *ptr = frameData(frame, size);
+    encoded.assign(ptr, ptr + size);
+    return true;
+}
+
+std::string FramePackSource::name(int frame) const
+{
+    return directory + FRAME_PACK_DATA + "#" + std::to_string(frame);
+}
+
+void FramePackSource::unmap()
+{
+    if (data) munmap(const_cast<uchar *>(data), datasize);
+    if (index) munmap(const_cast<uchar *>(index), indexsize);
+    data = nullptr;
+    index = nullptr;
+    datasize = 0;
+    indexsize = 0;
+    count = 0;
+}
@@ -0,0 +1,99 @@
+#ifndef FRAME_PACK_H
+#define FRAME_PACK_H
+
+#include "frame-source.h"
+#include <cstdint>
+
+/**
+ * Frame pack - append-only container for encoded frames.
+ *
+ * The pack consists of two files placed in the frames directory:
+ *
+ * - frames.pack - concatenated encoded frames,
+ * - frames.idx - a header followed by fixed-size entries holding the offset
+ *   and size of each frame in frames.pack.
+ *
+ * The frame data is always written before its index entry, so after a crash
+ * of the process the index describes only the frames that were written
+ * completely. Nothing is synced to the disk, so this does not hold after a
+ * power loss - the entries of frames missing in the data file are dropped
+ * when the pack is opened again, but a frame can still hold stale data.
+ */
+
+extern const char *FRAME_PACK_DATA;
+extern const char *FRAME_PACK_INDEX;
+
+struct FramePackHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entrysize;
+};
+
+struct FramePackEntry
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+/// Checks if directory (ending with '/') contains a frame pack
+bool hasFramePack(const std::string &directory);
+
+/**
+ * Appends frames to a new or an existing frame pack.
+ */
+class FramePackWriter : public FrameSink
+{
+public:
+    FramePackWriter();
+    ~FramePackWriter();
+
+    /// Opens the pack in directory (ending with '/') for appending, returns 0 on success
+    int open(const std::string &directory);
+
+    int append(const uchar *data, size_t size) override;
+
+    void close();
+
+private:
+    int datafd;
+    int indexfd;
+    uint64_t dataend;
+    uint64_t indexend;
+};
+
+/**
+ * Memory-mapped, read-only view of the frame pack.
+ */
+class FramePackSource : public FrameSource
+{
+public:
+    FramePackSource();
+    ~FramePackSource();
+
+    /// Maps the pack from directory (ending with '/'), returns 0 on success
+    int open(const std::string &directory);
+
+    int size() const override;
+    cv::Mat read(int index) override;
+    bool readEncoded(int index, std::vector<uchar> &data) override;
+    cv::Mat readReduced(int index, int scale) override;
+    std::string name(int index) const override;
+    bool threadSafe() const override { return true; }
+
+    /// Returns the pointer to the encoded frame inside the mapping
+    const uchar *frameData(int index, size_t &size) const;
+
+private:
+    void unmap();
+
+    std::string directory;
+    const uchar *data;
+    size_t datasize;
+    const uchar *index;
+    size_t indexsize;
+    int count;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "frame-source.h"
+#include "frame-pack.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+bool checkExtension(const char *name, const char *ext)
+{
+    return (strlen(name) >= strlen(ext)) && (!strcmp(name + strlen(name) - strlen(ext), ext));
+}
+
+int getFiles(std::string directory,
+                std::vector<std::string> &files, const char *ext)
+{
+    DIR *dp;
+    struct dirent *ep;
+    dp = opendir(directory.c_str());
+    if (dp != NULL)
+    {
+        ep = readdir(dp);
+        while (ep != NULL)
+        {
+            if (!ext || checkExtension(ep->d_name, ext))
+            {
+                if (strcmp(".", ep->d_name) != 0 &&
+                    strcmp("..", ep->d_name) != 0)
+                        files.push_back(directory + ep->d_name);
+            }
+            ep = readdir(dp);
+        }
+        closedir(dp);
+    }
+    else return -ENOENT;
+    return 0;
+}
+
+JpegDirectorySource::JpegDirectorySource(const std::vector<std::string> &paths)
+    : paths(paths)
+{
+}
+
+int JpegDirectorySource::size() const
+{
+    return paths.size();
+}
+
+cv::Mat JpegDirectorySource::read(int index)
+{
+    return cv::imread(paths[index]);
+}
+
+cv::Mat JpegDirectorySource::readReduced(int index, int scale)
+{
+    return cv::imread(paths[index], reducedReadFlags(scale));
+}
+
+bool JpegDirectorySource::readEncoded(int index, std::vector<uchar> &data)
+{
+    std::ifstream file(paths[index], std::ios::binary | std::ios::ate);
+    if (!file.good()) return false;
+    data.resize(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(data.data()), data.size());
+    return file.good();
+}
+
+cv::Mat FrameSource::readReduced(int index, int scale)
+{
+    return downscaleFrame(read(index), scale);
+}
+
+std::string FrameSource::filePath(int index) const
+{
+    return "";
+}
+
+int reducedReadFlags(int scale)
+{
+    switch (scale)
+    {
+        case 2:
+            return cv::IMREAD_REDUCED_COLOR_2;
+        case 4:
+            return cv::IMREAD_REDUCED_COLOR_4;
+        case 8:
+            return cv::IMREAD_REDUCED_COLOR_8;
+        default:
+            return cv::IMREAD_COLOR;
+    }
+}
+
+cv::Mat downscaleFrame(const cv::Mat &image, int scale)
+{
+    if (scale <= 1 || image.empty()) return image;
+    cv::Mat reduced;
+    cv::resize(image, reduced, cv::Size((image.cols + scale - 1) / scale, (image.rows + scale - 1) / scale), 0, 0, cv::INTER_AREA);
+    return reduced;
+}
+
+std::string JpegDirectorySource::filePath(int index) const
+{
+    return paths[index];
+}
+
+std::string JpegDirectorySource::name(int index) const
+{
+    return paths[index];
+}
+
+JpegDirectorySink::JpegDirectorySink(const std::string &directory)
+    : directory(directory), count(0)
+{
+}
+
+int JpegDirectorySink::append(const uchar *data, size_t size)
+{
+    std::ostringstream path;
+    path << directory;
+    path << std::setfill('0') << std::setw(8) << count;
+    path << ".jpg";
+    std::ofstream file(path.str(), std::ios::binary);
+    file.write(reinterpret_cast<const char *>(data), size);
+    if (!file.good())
+    {
+        printf("Failed to write frame %s\n", path.str().c_str());
+        return 1;
+    }
+    count++;
+    return 0;
+}
+
+std::unique_ptr<FrameSource> openFrameSource(const std::string &directory)
+{
+    if (hasFramePack(directory))
+    {
+        std::unique_ptr<FramePackSource> pack(new FramePackSource());
+        if (pack->open(directory) != 0 || pack->size() == 0) return nullptr;
+        return std::move(pack);
+    }
+    std::vector<std::string> paths;
+    if (getFiles(directory, paths, "jpg") != 0 || paths.size() == 0) return nullptr;
+    std::sort(paths.begin(), paths.end());
+    return std::unique_ptr<FrameSource>(new JpegDirectorySource(paths));
+}
+
+int copyFrames(FrameSource &source, FrameSink &sink)
+{
+    std::vector<uchar> data;
+    for (int i = 0; i < source.size(); i++)
+    {
+        if (!source.readEncoded(i, data))
+        {
+            printf("Failed to read frame %s\n", source.name(i).c_str());
+            return 1;
+        }
+        if (sink.append(data.data(), data.size()) != 0) return 1;
+    }
+    return 0;
+}
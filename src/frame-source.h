@@ -0,0 +1,129 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <opencv2/core/core.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Lists files with a given extension in the directory.
+ *
+ * directory should end with '/'. Returns 0 on success, -ENOENT if the
+ * directory cannot be opened.
+ */
+int getFiles(std::string directory, std::vector<std::string> &files, const char *ext);
+
+/**
+ * Read-only, random-access collection of frames of a single video sequence.
+ */
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    /// Number of frames in the source
+    virtual int size() const = 0;
+
+    /// Decodes the frame with a given index, returns an empty matrix on failure
+    virtual cv::Mat read(int index) = 0;
+
+    /// Reads the encoded (JPEG) representation of the frame, returns false on failure
+    virtual bool readEncoded(int index, std::vector<uchar> &data) = 0;
+
+    /// Checks if the frames are stored encoded, otherwise readEncoded() encodes the decoded frame
+    virtual bool storesEncoded() const { return true; }
+
+    /// Checks if the frames can be read from multiple threads at once
+    virtual bool threadSafe() const { return false; }
+
+    /**
+     * Decodes the frame downscaled by scale (1, 2, 4 or 8), for the readers
+     * that do not need the full resolution, like the tracker. The size is
+     * rounded up, as in the JPEG scaled decoding. By default the full frame
+     * is decoded and resized, the JPEG sources decode in the DCT domain at
+     * the reduced size directly.
+     */
+    virtual cv::Mat readReduced(int index, int scale);
+
+    /**
+     * Returns the path of the file holding exactly the encoded frame, so it
+     * can be copied as is, or an empty string if the frame has no file of
+     * its own (the default).
+     */
+    virtual std::string filePath(int index) const;
+
+    /// Human-readable name of the frame, used in logs
+    virtual std::string name(int index) const = 0;
+};
+
+/**
+ * Frames stored as separate JPEG files in a single directory.
+ */
+class JpegDirectorySource : public FrameSource
+{
+public:
+    explicit JpegDirectorySource(const std::vector<std::string> &paths);
+
+    int size() const override;
+    cv::Mat read(int index) override;
+    bool readEncoded(int index, std::vector<uchar> &data) override;
+    cv::Mat readReduced(int index, int scale) override;
+    std::string filePath(int index) const override;
+    std::string name(int index) const override;
+    bool threadSafe() const override { return true; }
+
+private:
+    std::vector<std::string> paths;
+};
+
+/// Returns the imread/imdecode flags decoding the JPEG downscaled by scale (1, 2, 4 or 8)
+int reducedReadFlags(int scale);
+
+/// Resizes the frame to the size of the frame decoded with the scale
+cv::Mat downscaleFrame(const cv::Mat &image, int scale);
+
+/**
+ * Destination for the encoded frames, frames are appended in order.
+ */
+class FrameSink
+{
+public:
+    virtual ~FrameSink() {}
+
+    /// Appends the encoded frame, returns 0 on success
+    virtual int append(const uchar *data, size_t size) = 0;
+};
+
+/**
+ * Writes frames as <index>.jpg files, starting from index 0.
+ */
+class JpegDirectorySink : public FrameSink
+{
+public:
+    explicit JpegDirectorySink(const std::string &directory);
+
+    int append(const uchar *data, size_t size) override;
+
+private:
+    std::string directory;
+    int count;
+};
+
+/**
+ * Opens the frames stored in the directory.
+ *
+ * If the directory contains a frame pack, it is used, otherwise the JPEG
+ * files from the directory are loaded in the lexicographical order.
+ * Returns nullptr if the directory cannot be read or holds no frames.
+ */
+std::unique_ptr<FrameSource> openFrameSource(const std::string &directory);
+
+/**
+ * Copies all frames from source to sink without re-encoding them.
+ *
+ * Returns 0 on success.
+ */
+int copyFrames(FrameSource &source, FrameSink &sink);
+
+#endif
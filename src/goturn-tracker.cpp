@@ -0,0 +1,97 @@
+#include "goturn-tracker.h"
+#include <algorithm>
+
+void GoturnTracker::init(const cv::Mat &image, const BoundingBox &bbox, int scale)
+{
+    // a new input is allocated on each step, so the saved states are never overwritten
+    cv::Mat target(1, NETWORK_INPUT_VALUES, CV_32FC1);
+    CropPlacement targetplacement;
+    cropNetworkInput(image, scale == 1 ? bbox : scaleBox(bbox, 1.0 / scale), target.ptr<float>(), targetplacement);
+    current.data = target;
+    current.box = bbox;
+}
+
+int GoturnTracker::reducedScale(int maxscale) const
+{
+    return reducedScale(current.box, maxscale);
+}
+
+int GoturnTracker::reducedScale(const BoundingBox &bbox, int maxscale)
+{
+    // the search region (and the target crop) is the box with GOTURN's context around it -
+    // compute_output_width() already includes the 2x context factor, so side is the crop itself
+    double side = std::min(bbox.compute_output_width(), bbox.compute_output_height());
+    maxscale = std::min(maxscale, MAX_REDUCED_SCALE);
+    int scale = 1;
+    // the scale is doubled while the crop still covers the network input at the doubled scale
+    while (scale < maxscale && side / (scale * 2) >= NETWORK_INPUT_SIZE) scale *= 2;
+    return scale;
+}
+
+void GoturnTracker::crop(const cv::Mat &image, int scale)
+{
+    if (search.empty()) search.create(1, NETWORK_INPUT_VALUES, CV_32FC1);
+    // the previous location is the prior for the search region
+    BoundingBox prior = scale == 1 ? current.box : scaleBox(current.box, 1.0 / scale);
+    cropNetworkInput(image, prior, search.ptr<float>(), placement);
+}
+
+void GoturnTracker::update(const cv::Mat &image, int scale, const BoundingBox &estimate, BoundingBox &bbox)
+{
+    uncropEstimate(image, placement, estimate, bbox);
+    if (scale != 1) bbox = scaleBox(bbox, scale);
+    init(image, bbox, scale);
+}
+
+void GoturnTracker::track(const cv::Mat &image, BoxRegressor &regressor, BoundingBox &bbox, int scale)
+{
+    std::vector<GoturnTracker *> trackers(1, this);
+    std::vector<BoundingBox> bboxes;
+    trackAll(trackers, image, regressor, bboxes, scale);
+    bbox = bboxes[0];
+}
+
+void GoturnTracker::trackAll(const std::vector<GoturnTracker *> &trackers, const cv::Mat &image, BoxRegressor &regressor,
+    std::vector<BoundingBox> &bboxes, int scale)
+{
+    std::vector<const float *> targets, searches;
+    for (GoturnTracker *tracker : trackers)
+    {
+        tracker->crop(image, scale);
+        targets.push_back(tracker->current.data.ptr<float>());
+        searches.push_back(tracker->search.ptr<float>());
+    }
+    std::vector<BoundingBox> estimates;
+    regressor.regressInputs(targets, searches, estimates);
+    bboxes.resize(trackers.size());
+    for (size_t i = 0; i < trackers.size(); i++) trackers[i]->update(image, scale, estimates[i], bboxes[i]);
+}
+
+GoturnBackend::GoturnBackend(BoxRegressor &regressor)
+    : regressor(regressor)
+{
+}
+
+std::string GoturnBackend::name() const
+{
+    return "goturn";
+}
+
+std::unique_ptr<ObjectTracker> GoturnBackend::createTracker()
+{
+    return std::unique_ptr<ObjectTracker>(new GoturnTracker());
+}
+
+int GoturnBackend::reducedScale(const BoundingBox &bbox, int maxscale) const
+{
+    return GoturnTracker::reducedScale(bbox, maxscale);
+}
+
+void GoturnBackend::trackObjects(const std::vector<ObjectTracker *> &trackers, const cv::Mat &image,
+    std::vector<BoundingBox> &bboxes, int scale)
+{
+    // the trackers are created by this backend
+    std::vector<GoturnTracker *> goturntrackers;
+    for (ObjectTracker *tracker : trackers) goturntrackers.push_back(static_cast<GoturnTracker *>(tracker));
+    GoturnTracker::trackAll(goturntrackers, image, regressor, bboxes, scale);
+}
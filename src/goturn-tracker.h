@@ -0,0 +1,77 @@
+#ifndef GOTURN_TRACKER_H
+#define GOTURN_TRACKER_H
+
+#include "box-regressor.h"
+#include "network-input.h"
+#include "tracker-backend.h"
+#include "helper/bounding_box.h"
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+/**
+ * GOTURN tracking step, running on any BoxRegressor.
+ *
+ * Equivalent to GOTURN's Tracker: the target is cropped around the box in
+ * the previous frame, the search region around the same box in the current
+ * frame, and the network estimate is mapped back to the frame coordinates.
+ *
+ * Only the target crop of the previous frame is kept between the steps, not
+ * the whole frame, so the state is small enough to be checkpointed. The
+ * crops are written straight to the preprocessed network inputs (see
+ * cropNetworkInput()), without the intermediate images. The state data is
+ * the target network input.
+ */
+class GoturnTracker : public ObjectTracker
+{
+public:
+    void init(const cv::Mat &image, const BoundingBox &bbox, int scale = 1) override;
+
+    /// Tracks the box to the next image downscaled by scale, bbox is set to the new location
+    void track(const cv::Mat &image, BoxRegressor &regressor, BoundingBox &bbox, int scale = 1);
+
+    /**
+     * Tracks the boxes of all trackers to the same next image, with a single
+     * batched regression. bboxes is set to the new locations, in the order
+     * of the trackers.
+     */
+    static void trackAll(const std::vector<GoturnTracker *> &trackers, const cv::Mat &image, BoxRegressor &regressor,
+        std::vector<BoundingBox> &bboxes, int scale = 1);
+
+    /// The search region stays at least as large as the network input, so the crop loses no detail
+    int reducedScale(int maxscale) const override;
+
+    /// Returns the largest scale the image can be downscaled by to start tracking the box
+    static int reducedScale(const BoundingBox &bbox, int maxscale);
+
+private:
+    void crop(const cv::Mat &image, int scale);
+    void update(const cv::Mat &image, int scale, const BoundingBox &estimate, BoundingBox &bbox);
+
+    /// Network input of the search region of the tracking step, reused by the steps
+    cv::Mat search;
+    /// Placement of the search region, needed to map the estimate back to the image
+    CropPlacement placement;
+};
+
+/**
+ * Tracker backend running GOTURN on the regressor, all objects tracked in a
+ * frame are regressed in a single batch.
+ */
+class GoturnBackend : public TrackerBackend
+{
+public:
+    explicit GoturnBackend(BoxRegressor &regressor);
+
+    std::string name() const override;
+    std::unique_ptr<ObjectTracker> createTracker() override;
+    int reducedScale(const BoundingBox &bbox, int maxscale) const override;
+
+protected:
+    void trackObjects(const std::vector<ObjectTracker *> &trackers, const cv::Mat &image,
+        std::vector<BoundingBox> &bboxes, int scale) override;
+
+private:
+    BoxRegressor &regressor;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "inference-device.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#ifdef USE_CAFFE
+#include <caffe/caffe.hpp>
+#endif
+
+// BLAS thread control functions, resolved only if the given library is linked
+extern "C" void openblas_set_num_threads(int threads) __attribute__((weak));
+extern "C" void MKL_Set_Num_Threads(int threads) __attribute__((weak));
+extern "C" void omp_set_num_threads(int threads) __attribute__((weak));
+
+const char *defaultInferenceDevice()
+{
+#ifdef CPU_ONLY
+    return "cpu";
+#else
+    return "gpu";
+#endif
+}
+
+int parseInferenceDevice(const std::string &name, InferenceDevice &device)
+{
+    if (name == "cpu")
+    {
+        device = InferenceDevice::CPU;
+        return 0;
+    }
+    if (name == "gpu")
+    {
+#ifdef CPU_ONLY
+        printf("GPU inference is not available, the application was built without CUDA\n");
+        return 1;
+#else
+        device = InferenceDevice::GPU;
+        return 0;
+#endif
+    }
+    printf("Unknown inference device:  %s\n", name.c_str());
+    return 1;
+}
+
+const char *inferenceDeviceName(InferenceDevice device)
+{
+    return device == InferenceDevice::GPU ? "GPU" : "CPU";
+}
+
+void setupInferenceDevice(InferenceDevice device, int gpuid)
+{
+#ifdef USE_CAFFE
+#ifndef CPU_ONLY
+    if (device == InferenceDevice::GPU)
+    {
+        caffe::Caffe::SetDevice(gpuid);
+        caffe::Caffe::set_mode(caffe::Caffe::GPU);
+        return;
+    }
+#endif
+    caffe::Caffe::set_mode(caffe::Caffe::CPU);
+#endif
+}
+
+int setBlasThreads(int threads)
+{
+    // for the libraries reading the settings from the environment on first use
+    std::string value = std::to_string(threads);
+    setenv("OPENBLAS_NUM_THREADS", value.c_str(), 1);
+    setenv("MKL_NUM_THREADS", value.c_str(), 1);
+    setenv("OMP_NUM_THREADS", value.c_str(), 1);
+
+    int applied = 0;
+    if (openblas_set_num_threads)
+    {
+        openblas_set_num_threads(threads);
+        applied++;
+    }
+    if (MKL_Set_Num_Threads)
+    {
+        MKL_Set_Num_Threads(threads);
+        applied++;
+    }
+    if (omp_set_num_threads)
+    {
+        omp_set_num_threads(threads);
+        applied++;
+    }
+    if (applied == 0)
+    {
+        printf("No supported BLAS library found, --cpu-threads is ignored\n");
+        return 1;
+    }
+    printf("BLAS threads set to %d\n", threads);
+    return 0;
+}
+
+TimedRegressor::TimedRegressor(BoxRegressor &regressor)
+    : regressor(regressor)
+{
+}
+
+void TimedRegressor::regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate)
+{
+    ScopedTimer timer;
+    regressor.regress(target, search, estimate);
+    stats.add(timer.stop());
+}
+
+void TimedRegressor::regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    ScopedTimer timer;
+    regressor.regressBatch(targets, searches, estimates);
+    stats.add(timer.stop());
+}
+
+void TimedRegressor::regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    ScopedTimer timer;
+    regressor.regressInputs(targets, searches, estimates);
+    stats.add(timer.stop());
+}
+
+const LatencyStats &TimedRegressor::latency() const
+{
+    return stats;
+}
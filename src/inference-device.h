@@ -0,0 +1,62 @@
+#ifndef INFERENCE_DEVICE_H
+#define INFERENCE_DEVICE_H
+
+#include "box-regressor.h"
+#include "latency-stats.h"
+#include <string>
+
+enum class InferenceDevice
+{
+    CPU,
+    GPU
+};
+
+/// Name of the default device - GPU, unless built without CUDA
+const char *defaultInferenceDevice();
+
+/// Parses "cpu" or "gpu", returns 0 on success
+int parseInferenceDevice(const std::string &name, InferenceDevice &device);
+
+const char *inferenceDeviceName(InferenceDevice device);
+
+/**
+ * Configures Caffe to run on the device, does nothing in builds without Caffe.
+ *
+ * Caffe mode is thread-local, so this has to be called in every thread
+ * that runs the network.
+ */
+void setupInferenceDevice(InferenceDevice device, int gpuid);
+
+/**
+ * Sets the number of threads used by the BLAS library in the CPU mode.
+ *
+ * Supports OpenBLAS, MKL and OpenMP-based BLAS implementations, whichever
+ * is linked. Returns 0 if any of them accepted the setting.
+ */
+int setBlasThreads(int threads);
+
+/**
+ * Regressor wrapper measuring the latency of each regression.
+ */
+class TimedRegressor : public BoxRegressor
+{
+public:
+    explicit TimedRegressor(BoxRegressor &regressor);
+
+    void regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate) override;
+
+    /// A batch is recorded as a single latency sample
+    void regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+    void regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+    const LatencyStats &latency() const;
+
+private:
+    BoxRegressor &regressor;
+    LatencyStats stats;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "int8-calibration.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+void Int8Calibration::observe(const std::string &layer, const float *input, size_t count)
+{
+    float &range = ranges[layer];
+    for (size_t i = 0; i < count; i++) range = std::max(range, input[i]);
+}
+
+float Int8Calibration::range(const std::string &layer) const
+{
+    std::map<std::string, float>::const_iterator found = ranges.find(layer);
+    return found == ranges.end() ? 0.0f : found->second;
+}
+
+bool Int8Calibration::empty() const
+{
+    return ranges.empty();
+}
+
+int Int8Calibration::load(const std::string &filename)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        printf("Unable to open the calibration:  %s\n", filename.c_str());
+        return 1;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line))
+    {
+        number++;
+        if (line.empty()) continue;
+        std::istringstream fields(line);
+        std::string layer;
+        float range;
+        if (!(fields >> layer >> range) || range < 0)
+        {
+            printf("Invalid calibration line %d:  %s\n", number, line.c_str());
+            return 1;
+        }
+        ranges[layer] = std::max(ranges[layer], range);
+    }
+    return 0;
+}
+
+int Int8Calibration::save(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    file.precision(9);
+    for (const std::pair<const std::string, float> &range : ranges)
+    {
+        file << range.first << " " << range.second << "\n";
+    }
+    if (!file)
+    {
+        printf("Unable to write the calibration:  %s\n", filename.c_str());
+        return 1;
+    }
+    return 0;
+}
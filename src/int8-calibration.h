@@ -0,0 +1,37 @@
+#ifndef INT8_CALIBRATION_H
+#define INT8_CALIBRATION_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+/**
+ * Activation ranges of the layers running in int8.
+ *
+ * The range of a layer is the largest input value seen during the
+ * calibration, the quantized layer maps [0, range] to its 7-bit inputs.
+ * Ranges only grow, so calibrations over several sequences can be merged
+ * by loading the previous ranges first.
+ */
+class Int8Calibration
+{
+public:
+    /// Extends the range of the layer with the input values
+    void observe(const std::string &layer, const float *input, size_t count);
+
+    /// Returns the range of the layer, 0 if it was not calibrated
+    float range(const std::string &layer) const;
+
+    bool empty() const;
+
+    /// Reads the ranges from the text file with a "layer range" line per layer, returns 0 on success
+    int load(const std::string &filename);
+
+    /// Writes the ranges in the format read by load(), returns 0 on success
+    int save(const std::string &filename) const;
+
+private:
+    std::map<std::string, float> ranges;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "latency-stats.h"
+#include <algorithm>
+#include <cstdio>
+
+void LatencyStats::add(double milliseconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    samples.push_back(milliseconds);
+}
+
+int LatencyStats::count() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return samples.size();
+}
+
+double LatencyStats::total() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    double sum = 0;
+    for (double sample : samples) sum += sample;
+    return sum;
+}
+
+double LatencyStats::mean() const
+{
+    int n = count();
+    return n > 0 ? total() / n : 0.0;
+}
+
+double LatencyStats::percentile(double p) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (samples.empty()) return 0.0;
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = std::min(sorted.size() - 1, (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+void LatencyStats::print(const std::string &label) const
+{
+    if (count() == 0)
+    {
+        printf("%s:  no samples\n", label.c_str());
+        return;
+    }
+    printf("%s:  %d samples, mean %.2fms, median %.2fms, p95 %.2fms, max %.2fms\n",
+        label.c_str(), count(), mean(), percentile(50), percentile(95), percentile(100));
+}
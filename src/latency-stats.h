@@ -0,0 +1,53 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Collects durations of repeated operations and summarizes them.
+ *
+ * Samples can be added from multiple threads.
+ */
+class LatencyStats
+{
+public:
+    /// Adds a sample, in milliseconds
+    void add(double milliseconds);
+
+    int count() const;
+    double mean() const;
+    double total() const;
+
+    /// Returns the p-th percentile (0-100) of the samples
+    double percentile(double p) const;
+
+    /// Prints the summary preceded by the label
+    void print(const std::string &label) const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<double> samples;
+};
+
+/**
+ * Measures the time from the construction to the stop() call.
+ */
+class ScopedTimer
+{
+public:
+    ScopedTimer() : start(std::chrono::steady_clock::now()) {}
+
+    /// Returns the elapsed time in milliseconds
+    double stop() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "low-rank-model.h"
+#include "caffemodel-reader.h"
+#include "prototxt.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <opencv2/core/core.hpp>
+
+namespace
+{
+
+/// Random directions sampled beyond the rank, for accurate trailing singular vectors
+const int OVERSAMPLING = 16;
+
+/// Power iterations of the randomized SVD, sharpening the slowly decaying spectrum
+const int POWER_ITERATIONS = 2;
+
+/// Orthonormalizes the columns of the matrix with the modified Gram-Schmidt process
+void orthonormalize(cv::Mat &columns)
+{
+    cv::Mat transposed;
+    cv::transpose(columns, transposed);
+    cv::Mat rows;
+    transposed.convertTo(rows, CV_64F);
+    for (int i = 0; i < rows.rows; i++)
+    {
+        double *row = rows.ptr<double>(i);
+        for (int j = 0; j < i; j++)
+        {
+            const double *previous = rows.ptr<double>(j);
+            double dot = 0.0;
+            for (int k = 0; k < rows.cols; k++) dot += row[k] * previous[k];
+            for (int k = 0; k < rows.cols; k++) row[k] -= dot * previous[k];
+        }
+        double norm = 0.0;
+        for (int k = 0; k < rows.cols; k++) norm += row[k] * row[k];
+        // a dependent column is dropped, it does not contribute to the range
+        double scale = norm > 1e-20 ? 1.0 / std::sqrt(norm) : 0.0;
+        for (int k = 0; k < rows.cols; k++) row[k] *= scale;
+    }
+    cv::transpose(rows, transposed);
+    transposed.convertTo(columns, CV_32F);
+}
+
+/**
+ * Computes the rank-k approximation basis * projected of the weights, with
+ * the orthonormal basis (outputs x rank) and projected = basis^T weights
+ * (rank x inputs). Returns the relative error in the Frobenius norm.
+ */
+double factorize(const cv::Mat &weights, int rank, cv::Mat &basis, cv::Mat &projected)
+{
+    // orthonormal basis of the range of the weights applied to random vectors
+    int samples = std::min(rank + OVERSAMPLING, std::min(weights.rows, weights.cols));
+    cv::Mat random(weights.cols, samples, CV_32F);
+    cv::RNG rng(0x5eed);
+    rng.fill(random, cv::RNG::NORMAL, 0.0, 1.0);
+    cv::Mat range;
+    cv::gemm(weights, random, 1.0, cv::noArray(), 0.0, range);
+    for (int i = 0; i < POWER_ITERATIONS; i++)
+    {
+        orthonormalize(range);
+        cv::Mat corange;
+        cv::gemm(weights, range, 1.0, cv::noArray(), 0.0, corange, cv::GEMM_1_T);
+        cv::gemm(weights, corange, 1.0, cv::noArray(), 0.0, range);
+    }
+    orthonormalize(range);
+
+    // the SVD of the small range^T weights follows from the eigenvectors of its Gram matrix
+    cv::Mat small;
+    cv::gemm(range, weights, 1.0, cv::noArray(), 0.0, small, cv::GEMM_1_T);
+    cv::Mat gram;
+    cv::mulTransposed(small, gram, false, cv::noArray(), 1.0, CV_64F);
+    cv::Mat eigenvalues, eigenvectors;
+    cv::eigen(gram, eigenvalues, eigenvectors);
+    cv::Mat leading;
+    eigenvectors.rowRange(0, rank).convertTo(leading, CV_32F);
+
+    cv::gemm(leading, small, 1.0, cv::noArray(), 0.0, projected);
+    cv::gemm(range, leading, 1.0, cv::noArray(), 0.0, basis, cv::GEMM_2_T);
+
+    // the basis is orthonormal, so the squared error is the energy not captured by the projection
+    double total = cv::norm(weights, cv::NORM_L2SQR);
+    double captured = cv::sum(eigenvalues.rowRange(0, rank))[0];
+    return total > 0.0 ? std::sqrt(std::max(0.0, 1.0 - captured / total)) : 0.0;
+}
+
+PrototxtNode scalarField(const std::string &name, const std::string &value)
+{
+    PrototxtNode field;
+    field.name = name;
+    field.value = value;
+    return field;
+}
+
+/// Inner product layer without bias, projecting the bottom blob to rank outputs
+PrototxtNode projectionLayer(const std::string &name, const std::string &bottom, int rank)
+{
+    PrototxtNode param;
+    param.name = "inner_product_param";
+    param.message = true;
+    param.children.push_back(scalarField("num_output", std::to_string(rank)));
+    param.children.push_back(scalarField("bias_term", "false"));
+
+    PrototxtNode layer;
+    layer.name = "layer";
+    layer.message = true;
+    layer.children.push_back(scalarField("name", quotePrototxt(name)));
+    layer.children.push_back(scalarField("type", quotePrototxt("InnerProduct")));
+    layer.children.push_back(scalarField("bottom", quotePrototxt(bottom)));
+    layer.children.push_back(scalarField("top", quotePrototxt(name)));
+    layer.children.push_back(param);
+    return layer;
+}
+
+size_t countWeights(const CaffeWeights &model)
+{
+    size_t count = 0;
+    for (const CaffeWeights::value_type &layer : model)
+    {
+        for (const CaffeBlob &blob : layer.second) count += blob.data.size();
+    }
+    return count;
+}
+
+}
+
+int compressModel(const std::string &prototxt, const std::string &caffemodel,
+    const std::vector<LowRankLayer> &layers, const std::string &prefix)
+{
+    PrototxtNode network;
+    if (readPrototxt(prototxt, network) != 0) return 1;
+    CaffeWeights model;
+    if (readCaffemodel(caffemodel, model) != 0) return 1;
+    size_t original = countWeights(model);
+
+    for (const LowRankLayer &layer : layers)
+    {
+        std::string lowname = layer.name + LOW_RANK_SUFFIX;
+        CaffeWeights::iterator blobs = model.find(layer.name);
+        if (blobs == model.end() || blobs->second.size() != 2 || model.count(lowname))
+        {
+            printf("The model has no weights of the uncompressed inner product layer %s\n", layer.name.c_str());
+            return 1;
+        }
+        CaffeBlob &weights = blobs->second[0];
+        int outputs = blobs->second[1].data.size();
+        int inputs = outputs > 0 ? weights.data.size() / outputs : 0;
+        if (inputs == 0 || (size_t)inputs * outputs != weights.data.size())
+        {
+            printf("Unexpected shape of the layer %s\n", layer.name.c_str());
+            return 1;
+        }
+        if (layer.rank <= 0 || layer.rank >= std::min(inputs, outputs))
+        {
+            printf("Rank %d is not lower than the rank of the %dx%d layer %s\n", layer.rank, outputs, inputs, layer.name.c_str());
+            return 1;
+        }
+
+        std::vector<PrototxtNode>::iterator definition = network.children.begin();
+        while (definition != network.children.end()
+            && !(definition->message && definition->name == "layer" && definition->string("name") == layer.name))
+        {
+            definition++;
+        }
+        if (definition == network.children.end() || definition->string("type") != "InnerProduct"
+            || definition->strings("bottom").size() != 1)
+        {
+            printf("The network has no inner product layer %s\n", layer.name.c_str());
+            return 1;
+        }
+
+        cv::Mat basis, projected;
+        double error = factorize(cv::Mat(outputs, inputs, CV_32F, weights.data.data()), layer.rank, basis, projected);
+        printf("%s:  rank %d, %d -> %d weights, relative error %.4f\n", layer.name.c_str(), layer.rank,
+            inputs * outputs, layer.rank * (inputs + outputs), error);
+
+        CaffeBlob projection;
+        projection.shape = { layer.rank, inputs };
+        projection.data.assign(projected.ptr<float>(), projected.ptr<float>() + layer.rank * inputs);
+        weights.shape = { outputs, layer.rank };
+        weights.data.assign(basis.ptr<float>(), basis.ptr<float>() + outputs * layer.rank);
+        model[lowname].push_back(projection);
+
+        // the original layer reads the projection, keeping its name, bias and top
+        std::string bottom = definition->string("bottom");
+        for (PrototxtNode &field : definition->children)
+        {
+            if (!field.message && field.name == "bottom") field.value = quotePrototxt(lowname);
+        }
+        network.children.insert(definition, projectionLayer(lowname, bottom, layer.rank));
+    }
+
+    std::string prototxtfile = prefix + ".prototxt";
+    std::ofstream file(prototxtfile);
+    file << writePrototxt(network);
+    if (!file)
+    {
+        printf("Unable to write the network definition:  %s\n", prototxtfile.c_str());
+        return 1;
+    }
+    std::string caffemodelfile = prefix + ".caffemodel";
+    if (writeCaffemodel(caffemodelfile, model) != 0) return 1;
+
+    size_t compressed = countWeights(model);
+    printf("Wrote %s and %s, %.1f MB -> %.1f MB of weights\n", prototxtfile.c_str(), caffemodelfile.c_str(),
+        original * sizeof(float) / 1048576.0, compressed * sizeof(float) / 1048576.0);
+    return 0;
+}
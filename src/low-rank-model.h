@@ -0,0 +1,34 @@
+#ifndef LOW_RANK_MODEL_H
+#define LOW_RANK_MODEL_H
+
+#include <string>
+#include <vector>
+
+/// Suffix of the layer projecting the input of a factorized inner product
+const char *const LOW_RANK_SUFFIX = "-low";
+
+/**
+ * Inner product layer to factorize, and the rank of its approximation.
+ */
+struct LowRankLayer
+{
+    std::string name;
+    int rank;
+};
+
+/**
+ * Writes the low-rank version of the network to PREFIX.prototxt and
+ * PREFIX.caffemodel.
+ *
+ * The weights W of each given layer are replaced by the product P (P^T W),
+ * where P holds the first left singular vectors of W, computed with a
+ * randomized SVD. The definition gets the inner product layer NAME-low
+ * with the P^T W weights and no bias, and the original layer keeps its
+ * name and bias with the weights P, so all backends run the compressed
+ * network as is. Prints the size and the approximation error of each
+ * layer. Returns 0 on success.
+ */
+int compressModel(const std::string &prototxt, const std::string &caffemodel,
+    const std::vector<LowRankLayer> &layers, const std::string &prefix);
+
+#endif
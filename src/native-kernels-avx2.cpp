@@ -0,0 +1,81 @@
+// Compiled with -mavx2 -mfma, called only after checking the CPU support
+#include "native-kernels.h"
+#include "native-kernels-impl.h"
+#include <immintrin.h>
+
+namespace
+{
+
+struct Avx2Vector
+{
+    typedef __m256 type;
+    static const int width = 8;
+
+    static type zero() { return _mm256_setzero_ps(); }
+    static type load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, type v) { _mm256_storeu_ps(p, v); }
+    static type broadcast(float x) { return _mm256_set1_ps(x); }
+    static type fma(type a, type b, type c) { return _mm256_fmadd_ps(a, b, c); }
+    static type max(type a, type b) { return _mm256_max_ps(a, b); }
+
+    static float sum(type v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_movehdup_ps(s));
+        return _mm_cvtss_f32(s);
+    }
+
+    /// Gathers the 32-bit words holding the bytes at their low (forward) or high (backward) end
+    static type gatherBytes(const uint8_t *base, const int32_t *offsets, bool backward)
+    {
+        __m256i index = _mm256_loadu_si256((const __m256i *)offsets);
+        __m256i words;
+        if (backward) words = _mm256_srli_epi32(_mm256_i32gather_epi32((const int *)(base - 3), index, 1), 24);
+        else words = _mm256_and_si256(_mm256_i32gather_epi32((const int *)base, index, 1), _mm256_set1_epi32(0xff));
+        return _mm256_cvtepi32_ps(words);
+    }
+};
+
+struct Avx2Bytes
+{
+    typedef __m256i type;
+    typedef __m256i input;
+    typedef __m256i weight;
+    static const int width = 32;
+
+    static type zero() { return _mm256_setzero_si256(); }
+    static input loadInput(const uint8_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    static weight loadWeight(const int8_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+
+    /// The unsigned by signed byte products are summed in int16 pairs, then in int32 quadruples
+    static type dot(type sums, input x, weight w)
+    {
+        __m256i pairs = _mm256_maddubs_epi16(x, w);
+        return _mm256_add_epi32(sums, _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+    }
+
+    static int32_t sum(type v)
+    {
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+        return _mm_cvtsi128_si32(s);
+    }
+};
+
+}
+
+const NativeKernels &avx2Kernels()
+{
+    static const NativeKernels kernels = {
+        "avx2",
+        Avx2Vector::width,
+        convolutionItems<Avx2Vector>,
+        convolve<Avx2Vector>,
+        innerProduct<Avx2Vector>,
+        quantizedProduct<Avx2Bytes>,
+        cropResize<Avx2Vector>
+    };
+    return kernels;
+}
@@ -0,0 +1,68 @@
+// Compiled with -mavx512f -mavx512bw, called only after checking the CPU support
+#include "native-kernels.h"
+#include "native-kernels-impl.h"
+#include <immintrin.h>
+
+namespace
+{
+
+struct Avx512Vector
+{
+    typedef __m512 type;
+    static const int width = 16;
+
+    static type zero() { return _mm512_setzero_ps(); }
+    static type load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, type v) { _mm512_storeu_ps(p, v); }
+    static type broadcast(float x) { return _mm512_set1_ps(x); }
+    static type fma(type a, type b, type c) { return _mm512_fmadd_ps(a, b, c); }
+    static type max(type a, type b) { return _mm512_max_ps(a, b); }
+    static float sum(type v) { return _mm512_reduce_add_ps(v); }
+
+    /// Gathers the 32-bit words holding the bytes at their low (forward) or high (backward) end
+    static type gatherBytes(const uint8_t *base, const int32_t *offsets, bool backward)
+    {
+        __m512i index = _mm512_loadu_si512(offsets);
+        __m512i words;
+        if (backward) words = _mm512_srli_epi32(_mm512_i32gather_epi32(index, base - 3, 1), 24);
+        else words = _mm512_and_si512(_mm512_i32gather_epi32(index, base, 1), _mm512_set1_epi32(0xff));
+        return _mm512_cvtepi32_ps(words);
+    }
+};
+
+struct Avx512Bytes
+{
+    typedef __m512i type;
+    typedef __m512i input;
+    typedef __m512i weight;
+    static const int width = 64;
+
+    static type zero() { return _mm512_setzero_si512(); }
+    static input loadInput(const uint8_t *p) { return _mm512_loadu_si512(p); }
+    static weight loadWeight(const int8_t *p) { return _mm512_loadu_si512(p); }
+
+    /// The unsigned by signed byte products are summed in int16 pairs, then in int32 quadruples
+    static type dot(type sums, input x, weight w)
+    {
+        __m512i pairs = _mm512_maddubs_epi16(x, w);
+        return _mm512_add_epi32(sums, _mm512_madd_epi16(pairs, _mm512_set1_epi16(1)));
+    }
+
+    static int32_t sum(type v) { return _mm512_reduce_add_epi32(v); }
+};
+
+}
+
+const NativeKernels &avx512Kernels()
+{
+    static const NativeKernels kernels = {
+        "avx512",
+        Avx512Vector::width,
+        convolutionItems<Avx512Vector>,
+        convolve<Avx512Vector>,
+        innerProduct<Avx512Vector>,
+        quantizedProduct<Avx512Bytes>,
+        cropResize<Avx512Vector>
+    };
+    return kernels;
+}
@@ -0,0 +1,224 @@
+// Compares the kernels of each instruction set supported by the CPU with the
+// generic ones on random tensors, needs neither Caffe nor a model
+#include "native-kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+std::mt19937 generator(2024);
+
+std::vector<float> randomFloats(size_t count, float low, float high)
+{
+    std::uniform_real_distribution<float> distribution(low, high);
+    std::vector<float> values(count);
+    for (float &value : values) value = distribution(generator);
+    return values;
+}
+
+/// Largest difference relative to the magnitude of the expected values
+double difference(const std::vector<float> &expected, const std::vector<float> &actual)
+{
+    double largest = 0.0, scale = 1.0;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        largest = std::max(largest, (double)std::abs(expected[i] - actual[i]));
+        scale = std::max(scale, (double)std::abs(expected[i]));
+    }
+    return largest / scale;
+}
+
+/// Repacks [output][input][ky][kx] weights to [group][block][input][ky][kx][lane] like NativeWeights
+std::vector<float> packWeights(const std::vector<float> &weights, int outputs, int groupinputs, int area, int width)
+{
+    std::vector<float> packed(weights.size());
+    for (int output = 0; output < outputs; output++)
+    {
+        for (int input = 0; input < groupinputs; input++)
+        {
+            for (int k = 0; k < area; k++)
+            {
+                size_t index = ((size_t)(output / width * groupinputs + input) * area + k) * width + output % width;
+                packed[index] = weights[((size_t)output * groupinputs + input) * area + k];
+            }
+        }
+    }
+    return packed;
+}
+
+std::vector<float> convolve(const NativeKernels &kernels, int stride, bool relu)
+{
+    ConvolutionTask task;
+    task.inputs = 6;
+    task.outputs = 32;
+    task.groups = 2;
+    task.kernel = 3;
+    task.stride = stride;
+    task.outheight = 9;
+    task.outwidth = 13;
+    task.paddedheight = (task.outheight - 1) * stride + task.kernel;
+    task.paddedwidth = (task.outwidth - 1) * stride + task.kernel;
+    task.relu = relu;
+    generator.seed(stride);
+    std::vector<float> input = randomFloats((size_t)task.inputs * task.paddedheight * task.paddedwidth, -1.0f, 1.0f);
+    std::vector<float> weights = randomFloats((size_t)task.outputs * task.inputs / task.groups * task.kernel * task.kernel, -1.0f, 1.0f);
+    std::vector<float> bias = randomFloats(task.outputs, -1.0f, 1.0f);
+    std::vector<float> packed = packWeights(weights, task.outputs, task.inputs / task.groups, task.kernel * task.kernel, kernels.vectorwidth);
+    std::vector<float> output((size_t)task.outputs * task.outheight * task.outwidth);
+    task.input = input.data();
+    task.weights = packed.data();
+    task.bias = bias.data();
+    task.output = output.data();
+    kernels.convolve(task, 0, kernels.convolutionItems(task));
+    return output;
+}
+
+std::vector<float> innerProduct(const NativeKernels &kernels)
+{
+    InnerProductTask task;
+    task.inputs = 37;
+    task.outputs = 13;
+    task.batch = 3;
+    task.relu = true;
+    generator.seed(1);
+    std::vector<float> input = randomFloats((size_t)task.inputs * task.batch, -1.0f, 1.0f);
+    std::vector<float> weights = randomFloats((size_t)task.inputs * task.outputs, -1.0f, 1.0f);
+    std::vector<float> bias = randomFloats(task.outputs, -1.0f, 1.0f);
+    std::vector<float> output((size_t)task.outputs * task.batch);
+    task.input = input.data();
+    task.weights = weights.data();
+    task.bias = bias.data();
+    task.output = output.data();
+    kernels.innerProduct(task, 0, task.outputs);
+    return output;
+}
+
+std::vector<float> quantizedProduct(const NativeKernels &kernels)
+{
+    QuantizedTask task;
+    task.rows = 9;
+    task.columns = 70;
+    task.depth = 2 * QUANTIZED_ALIGNMENT;
+    task.outputstride = task.columns;
+    task.columnstride = 1;
+    task.relu = false;
+    generator.seed(2);
+    std::uniform_int_distribution<int> inputdistribution(0, QUANTIZED_INPUT_MAX);
+    std::uniform_int_distribution<int> weightdistribution(-QUANTIZED_WEIGHT_MAX, QUANTIZED_WEIGHT_MAX);
+    std::vector<uint8_t> inputs((size_t)task.columns * task.depth);
+    for (uint8_t &value : inputs) value = inputdistribution(generator);
+    std::vector<int8_t> weights((size_t)task.rows * task.depth);
+    for (int8_t &value : weights) value = weightdistribution(generator);
+    std::vector<float> scales = randomFloats(task.rows, 0.001f, 0.01f);
+    std::vector<float> bias = randomFloats(task.rows, -1.0f, 1.0f);
+    std::vector<float> output((size_t)task.rows * task.columns);
+    task.inputs = inputs.data();
+    task.weights = weights.data();
+    task.scales = scales.data();
+    task.bias = bias.data();
+    task.output = output.data();
+    kernels.quantizedProduct(task, 0, task.rows);
+    return output;
+}
+
+std::vector<float> cropResize(const NativeKernels &kernels, int height)
+{
+    const int width = 50, size = 37;
+    generator.seed(3);
+    std::uniform_int_distribution<int> bytes(0, 255);
+    std::vector<uint8_t> image((size_t)width * height * 3);
+    for (uint8_t &value : image) value = bytes(generator);
+    // the samples run from the padding left and above the image to past its right and bottom edges
+    std::vector<int32_t> columns(2 * size);
+    std::vector<int> rows(2 * size);
+    std::vector<float> columnweights = randomFloats(2 * size, 0.0f, 1.0f);
+    std::vector<float> rowweights = randomFloats(size, 0.0f, 1.0f);
+    for (int i = 0; i < size; i++)
+    {
+        int x = i * (width + 4) / size - 2, y = i * (height + 4) / size - 2;
+        columns[i] = x >= 0 && x < width ? 3 * x : 0;
+        columns[size + i] = x + 1 >= 0 && x + 1 < width ? 3 * (x + 1) : 0;
+        if (x < 0 || x >= width) columnweights[i] = 0.0f;
+        if (x + 1 < 0 || x + 1 >= width) columnweights[size + i] = 0.0f;
+        rows[i] = y >= 0 && y < height ? y : -1;
+        rows[size + i] = y + 1 >= 0 && y + 1 < height ? y + 1 : -1;
+    }
+    float mean[3] = { 104.0f, 117.0f, 123.0f };
+    std::vector<float> scratch(6 * size);
+    std::vector<float> output(3 * size * size);
+    CropResizeTask task;
+    task.image = image.data();
+    task.step = 3 * width;
+    task.height = height;
+    task.columns = columns.data();
+    task.columnweights = columnweights.data();
+    task.rows = rows.data();
+    task.rowweights = rowweights.data();
+    task.mean = mean;
+    task.scratch = scratch.data();
+    task.output = output.data();
+    task.size = size;
+    kernels.cropResize(task, 0, size);
+    return output;
+}
+
+/// Compares the kernels with the generic ones, returns the number of failed comparisons
+int compare(const NativeKernels &kernels)
+{
+    const NativeKernels &reference = genericKernels();
+    const double tolerance = 1e-5;
+    struct Comparison
+    {
+        const char *name;
+        std::vector<float> expected;
+        std::vector<float> actual;
+    };
+    std::vector<Comparison> comparisons = {
+        { "convolution", convolve(reference, 1, false), convolve(kernels, 1, false) },
+        { "strided convolution with ReLU", convolve(reference, 2, true), convolve(kernels, 2, true) },
+        { "inner product", innerProduct(reference), innerProduct(kernels) },
+        { "quantized product", quantizedProduct(reference), quantizedProduct(kernels) },
+        { "crop and resize", cropResize(reference, 40), cropResize(kernels, 40) },
+        { "crop and resize of a single row", cropResize(reference, 1), cropResize(kernels, 1) }
+    };
+    int failed = 0;
+    for (const Comparison &comparison : comparisons)
+    {
+        double error = difference(comparison.expected, comparison.actual);
+        bool passed = error <= tolerance;
+        printf("%-8s %-32s %s (relative difference %g)\n", kernels.name, comparison.name, passed ? "OK" : "FAILED", error);
+        if (!passed) failed++;
+    }
+    return failed;
+}
+
+}
+
+int main()
+{
+    int failed = 0;
+    int compared = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+#ifdef NATIVE_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        failed += compare(avx2Kernels());
+        compared++;
+    }
+#endif
+#ifdef NATIVE_HAVE_AVX512
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+        failed += compare(avx512Kernels());
+        compared++;
+    }
+#endif
+#endif
+    if (compared == 0) printf("No vectorized kernels supported by the CPU, nothing to compare\n");
+    return failed == 0 ? 0 : 1;
+}
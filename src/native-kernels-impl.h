@@ -0,0 +1,325 @@
+#ifndef NATIVE_KERNELS_IMPL_H
+#define NATIVE_KERNELS_IMPL_H
+
+/**
+ * Kernel implementations shared by all instruction sets.
+ *
+ * Included by the per-instruction-set translation units, each of them
+ * compiled with its own target flags. The vector type V provides:
+ *   type, width, zero(), load(p), store(p, v), broadcast(x),
+ *   fma(a, b, c) = a * b + c, max(a, b), sum(v),
+ *   gatherBytes(base, offsets, backward) = the bytes base[offsets[i]] as floats,
+ *     reading the 3 bytes before (backward) or after each of them
+ * The quantized products use the byte vector type Q providing:
+ *   type, input, weight, width (bytes), zero(), loadInput(p), loadWeight(p),
+ *   dot(sums, x, w) = sums + products of x and w summed in 32-bit lanes,
+ *   sum(sums)
+ */
+
+#include "native-kernels.h"
+#include <cstddef>
+
+namespace
+{
+
+/// Number of output pixels computed at once, sharing the weight loads
+const int TILE = 6;
+
+/// Number of input columns of the quantized products reused from the cache by consecutive rows
+const int COLUMN_TILE = 64;
+
+template <typename V>
+int convolutionItems(const ConvolutionTask &task)
+{
+    return task.groups * (task.outputs / task.groups / V::width) * task.outheight;
+}
+
+/// Accumulates count output pixels of the row, starting at column x
+template <typename V, int count>
+inline void convolveTile(const ConvolutionTask &task, const float *input, const float *weights, int y, int x,
+    typename V::type *accumulators)
+{
+    const int K = task.kernel;
+    const int S = task.stride;
+    const int planesize = task.paddedheight * task.paddedwidth;
+    const int channels = task.inputs / task.groups;
+
+    typename V::type sum[count];
+    for (int t = 0; t < count; t++) sum[t] = accumulators[t];
+
+    for (int c = 0; c < channels; c++)
+    {
+        const float *plane = input + c * planesize;
+        for (int ky = 0; ky < K; ky++)
+        {
+            const float *row = plane + (y * S + ky) * task.paddedwidth + x * S;
+            const float *w = weights + ((c * K + ky) * K) * V::width;
+            for (int kx = 0; kx < K; kx++)
+            {
+                typename V::type wv = V::load(w + kx * V::width);
+                for (int t = 0; t < count; t++)
+                {
+                    sum[t] = V::fma(V::broadcast(row[t * S + kx]), wv, sum[t]);
+                }
+            }
+        }
+    }
+
+    for (int t = 0; t < count; t++) accumulators[t] = sum[t];
+}
+
+template <typename V, int count>
+inline void storeTile(const ConvolutionTask &task, const typename V::type *accumulators, float *output, int x)
+{
+    const int planesize = task.outheight * task.outwidth;
+    float lanes[V::width];
+    for (int t = 0; t < count; t++)
+    {
+        typename V::type value = accumulators[t];
+        if (task.relu) value = V::max(value, V::zero());
+        V::store(lanes, value);
+        for (int lane = 0; lane < V::width; lane++)
+        {
+            output[lane * planesize + x + t] = lanes[lane];
+        }
+    }
+}
+
+template <typename V>
+void convolve(const ConvolutionTask &task, int begin, int end)
+{
+    const int K = task.kernel;
+    const int groupoutputs = task.outputs / task.groups;
+    const int groupinputs = task.inputs / task.groups;
+    const int blocks = groupoutputs / V::width;
+    const int blocksize = groupinputs * K * K * V::width;
+
+    for (int item = begin; item < end; item++)
+    {
+        int y = item % task.outheight;
+        int block = item / task.outheight % blocks;
+        int group = item / task.outheight / blocks;
+
+        const float *input = task.input + group * groupinputs * task.paddedheight * task.paddedwidth;
+        const float *weights = task.weights + (group * blocks + block) * blocksize;
+        int firstoutput = group * groupoutputs + block * V::width;
+        float *output = task.output + firstoutput * task.outheight * task.outwidth + y * task.outwidth;
+
+        float biases[V::width];
+        for (int lane = 0; lane < V::width; lane++) biases[lane] = task.bias[firstoutput + lane];
+        typename V::type bias = V::load(biases);
+
+        typename V::type accumulators[TILE];
+        int x = 0;
+        for (; x + TILE <= task.outwidth; x += TILE)
+        {
+            for (int t = 0; t < TILE; t++) accumulators[t] = bias;
+            convolveTile<V, TILE>(task, input, weights, y, x, accumulators);
+            storeTile<V, TILE>(task, accumulators, output, x);
+        }
+        for (; x < task.outwidth; x++)
+        {
+            accumulators[0] = bias;
+            convolveTile<V, 1>(task, input, weights, y, x, accumulators);
+            storeTile<V, 1>(task, accumulators, output, x);
+        }
+    }
+}
+
+/// Matrix product with the batch, four weight rows at a time to reuse the input loads
+template <typename V>
+void innerProduct(const InnerProductTask &task, int begin, int end)
+{
+    const int N = task.inputs;
+    const int vectorized = N / V::width * V::width;
+
+    int row = begin;
+    for (; row + 4 <= end; row += 4)
+    {
+        const float *w0 = task.weights + (size_t)row * N;
+        const float *w1 = w0 + N;
+        const float *w2 = w1 + N;
+        const float *w3 = w2 + N;
+        // the rows stay cached while they are applied to the samples
+        for (int sample = 0; sample < task.batch; sample++)
+        {
+            const float *input = task.input + (size_t)sample * N;
+            float *output = task.output + (size_t)sample * task.outputs;
+            typename V::type s0 = V::zero(), s1 = V::zero(), s2 = V::zero(), s3 = V::zero();
+            for (int i = 0; i < vectorized; i += V::width)
+            {
+                typename V::type x = V::load(input + i);
+                s0 = V::fma(V::load(w0 + i), x, s0);
+                s1 = V::fma(V::load(w1 + i), x, s1);
+                s2 = V::fma(V::load(w2 + i), x, s2);
+                s3 = V::fma(V::load(w3 + i), x, s3);
+            }
+            float sums[4] = { V::sum(s0), V::sum(s1), V::sum(s2), V::sum(s3) };
+            for (int i = vectorized; i < N; i++)
+            {
+                sums[0] += w0[i] * input[i];
+                sums[1] += w1[i] * input[i];
+                sums[2] += w2[i] * input[i];
+                sums[3] += w3[i] * input[i];
+            }
+            for (int r = 0; r < 4; r++)
+            {
+                float value = sums[r] + task.bias[row + r];
+                output[row + r] = task.relu && value < 0 ? 0 : value;
+            }
+        }
+    }
+    for (; row < end; row++)
+    {
+        const float *w = task.weights + (size_t)row * N;
+        for (int sample = 0; sample < task.batch; sample++)
+        {
+            const float *input = task.input + (size_t)sample * N;
+            typename V::type s = V::zero();
+            for (int i = 0; i < vectorized; i += V::width)
+            {
+                s = V::fma(V::load(w + i), V::load(input + i), s);
+            }
+            float value = V::sum(s);
+            for (int i = vectorized; i < N; i++) value += w[i] * input[i];
+            value += task.bias[row];
+            task.output[(size_t)sample * task.outputs + row] = task.relu && value < 0 ? 0 : value;
+        }
+    }
+}
+
+/// Computes R rows by C columns of the quantized products, sharing the loads
+template <typename Q, int R, int C>
+inline void quantizedBlock(const QuantizedTask &task, int row, int column)
+{
+    const int8_t *weights[R];
+    for (int r = 0; r < R; r++) weights[r] = task.weights + (size_t)(row + r) * task.depth;
+    const uint8_t *inputs[C];
+    for (int c = 0; c < C; c++) inputs[c] = task.inputs + (size_t)(column + c) * task.depth;
+
+    typename Q::type sums[R][C];
+    for (int r = 0; r < R; r++)
+    {
+        for (int c = 0; c < C; c++) sums[r][c] = Q::zero();
+    }
+    for (int i = 0; i < task.depth; i += Q::width)
+    {
+        typename Q::input x[C];
+        for (int c = 0; c < C; c++) x[c] = Q::loadInput(inputs[c] + i);
+        for (int r = 0; r < R; r++)
+        {
+            typename Q::weight w = Q::loadWeight(weights[r] + i);
+            for (int c = 0; c < C; c++) sums[r][c] = Q::dot(sums[r][c], x[c], w);
+        }
+    }
+
+    for (int r = 0; r < R; r++)
+    {
+        for (int c = 0; c < C; c++)
+        {
+            float value = task.scales[row + r] * Q::sum(sums[r][c]) + task.bias[row + r];
+            task.output[(size_t)(row + r) * task.outputstride + (size_t)(column + c) * task.columnstride] = task.relu && value < 0 ? 0 : value;
+        }
+    }
+}
+
+template <typename Q>
+void quantizedProduct(const QuantizedTask &task, int begin, int end)
+{
+    for (int first = 0; first < task.columns; first += COLUMN_TILE)
+    {
+        int last = first + COLUMN_TILE < task.columns ? first + COLUMN_TILE : task.columns;
+        int row = begin;
+        for (; row + 4 <= end; row += 4)
+        {
+            int column = first;
+            for (; column + 2 <= last; column += 2) quantizedBlock<Q, 4, 2>(task, row, column);
+            for (; column < last; column++) quantizedBlock<Q, 4, 1>(task, row, column);
+        }
+        for (; row < end; row++)
+        {
+            for (int column = first; column < last; column++) quantizedBlock<Q, 1, 1>(task, row, column);
+        }
+    }
+}
+
+/// Interpolates the source row horizontally into the planes of the scratch buffer, -1 is the padding
+template <typename V>
+inline void interpolateRow(const CropResizeTask &task, int index, float *planes)
+{
+    const int size = task.size;
+    if (index < 0)
+    {
+        for (int i = 0; i < 3 * size; i++) planes[i] = 0.0f;
+        return;
+    }
+    const uint8_t *row = task.image + index * task.step;
+    const int32_t *lefts = task.columns;
+    const int32_t *rights = task.columns + size;
+    const float *leftweights = task.columnweights;
+    const float *rightweights = task.columnweights + size;
+    // the gathers read whole words around the samples, towards the rows that exist
+    bool backward = index > 0;
+    int vectorized = backward || task.height > 1 ? size / V::width * V::width : 0;
+    for (int c = 0; c < 3; c++)
+    {
+        const uint8_t *channel = row + c;
+        float *plane = planes + c * size;
+        for (int x = 0; x < vectorized; x += V::width)
+        {
+            typename V::type value = V::fma(V::gatherBytes(channel, lefts + x, backward), V::load(leftweights + x), V::zero());
+            V::store(plane + x, V::fma(V::gatherBytes(channel, rights + x, backward), V::load(rightweights + x), value));
+        }
+        for (int x = vectorized; x < size; x++)
+        {
+            plane[x] = channel[lefts[x]] * leftweights[x] + channel[rights[x]] * rightweights[x];
+        }
+    }
+}
+
+template <typename V>
+void cropResize(const CropResizeTask &task, int begin, int end)
+{
+    const int size = task.size;
+    const size_t planesize = (size_t)size * size;
+    float *top = task.scratch;
+    float *bottom = task.scratch + 3 * size;
+    for (int y = begin; y < end; y++)
+    {
+        int first = task.rows[y];
+        int second = task.rows[size + y];
+        interpolateRow<V>(task, first, top);
+        // consecutive source rows are often the same when the crop is enlarged
+        const float *lower = top;
+        if (second != first)
+        {
+            interpolateRow<V>(task, second, bottom);
+            lower = bottom;
+        }
+
+        float weight = task.rowweights[y];
+        typename V::type bottomweight = V::broadcast(weight);
+        typename V::type topweight = V::broadcast(1.0f - weight);
+        for (int c = 0; c < 3; c++)
+        {
+            const float *upperplane = top + c * size;
+            const float *lowerplane = lower + c * size;
+            float *output = task.output + c * planesize + (size_t)y * size;
+            typename V::type mean = V::broadcast(-task.mean[c]);
+            int x = 0;
+            for (; x + V::width <= size; x += V::width)
+            {
+                typename V::type value = V::fma(V::load(upperplane + x), topweight, mean);
+                V::store(output + x, V::fma(V::load(lowerplane + x), bottomweight, value));
+            }
+            for (; x < size; x++)
+            {
+                output[x] = upperplane[x] * (1.0f - weight) + lowerplane[x] * weight - task.mean[c];
+            }
+        }
+    }
+}
+
+}
+
+#endif
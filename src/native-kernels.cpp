@@ -0,0 +1,85 @@
+#include "native-kernels.h"
+#include "native-kernels-impl.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+/// Plain scalar implementation, left for the compiler to vectorize
+struct ScalarVector
+{
+    typedef float type;
+    static const int width = 1;
+
+    static type zero() { return 0.0f; }
+    static type load(const float *p) { return *p; }
+    static void store(float *p, type v) { *p = v; }
+    static type broadcast(float x) { return x; }
+    static type fma(type a, type b, type c) { return a * b + c; }
+    static type max(type a, type b) { return a > b ? a : b; }
+    static float sum(type v) { return v; }
+    static type gatherBytes(const uint8_t *base, const int32_t *offsets, bool) { return base[*offsets]; }
+};
+
+/// Scalar byte products, the input and weight "vectors" are pointers to width bytes
+struct ScalarBytes
+{
+    typedef int32_t type;
+    typedef const uint8_t *input;
+    typedef const int8_t *weight;
+    static const int width = 16;
+
+    static type zero() { return 0; }
+    static input loadInput(const uint8_t *p) { return p; }
+    static weight loadWeight(const int8_t *p) { return p; }
+
+    static type dot(type sums, input x, weight w)
+    {
+        for (int i = 0; i < width; i++) sums += x[i] * w[i];
+        return sums;
+    }
+
+    static int32_t sum(type sums) { return sums; }
+};
+
+}
+
+const NativeKernels &genericKernels()
+{
+    static const NativeKernels kernels = {
+        "generic",
+        ScalarVector::width,
+        convolutionItems<ScalarVector>,
+        convolve<ScalarVector>,
+        innerProduct<ScalarVector>,
+        quantizedProduct<ScalarBytes>,
+        cropResize<ScalarVector>
+    };
+    return kernels;
+}
+
+const NativeKernels &selectNativeKernels()
+{
+    const char *forced = getenv("NATIVE_KERNELS");
+    if (forced && strcmp(forced, "generic") == 0) return genericKernels();
+#ifdef NATIVE_HAVE_AVX512
+    if (forced && strcmp(forced, "avx512") == 0) return avx512Kernels();
+#endif
+#ifdef NATIVE_HAVE_AVX2
+    if (forced && strcmp(forced, "avx2") == 0) return avx2Kernels();
+#endif
+    if (forced) printf("Kernels %s are not available, selecting automatically\n", forced);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+#ifdef NATIVE_HAVE_AVX512
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return avx512Kernels();
+#endif
+#ifdef NATIVE_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2Kernels();
+#endif
+#endif
+    return genericKernels();
+}
@@ -0,0 +1,161 @@
+#ifndef NATIVE_KERNELS_H
+#define NATIVE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Compute kernels of the native inference engine.
+ *
+ * The kernels are compiled separately for each supported instruction set
+ * and the best one available on the CPU is selected at runtime.
+ */
+
+/**
+ * Direct (im2col-free) convolution.
+ *
+ * The input is planar (channels x paddedheight x paddedwidth) and already
+ * padded. The weights are packed per group and block of vectorwidth output
+ * channels as [input channel][ky][kx][vectorwidth], so a single vector load
+ * gives the weights of all output channels in the block.
+ *
+ * The work is split into items - (group, output channel block, output row)
+ * triplets - so the kernel can be run in parallel over the item ranges.
+ */
+struct ConvolutionTask
+{
+    const float *input;
+    int paddedheight;
+    int paddedwidth;
+    const float *weights;
+    const float *bias;
+    float *output;
+    int inputs;
+    int outputs;
+    int outheight;
+    int outwidth;
+    int kernel;
+    int stride;
+    int groups;
+    bool relu;
+};
+
+/**
+ * Fully connected layer - weights are stored as outputs x inputs.
+ *
+ * The inputs (and outputs) of the batch samples are stored one after
+ * another. Each block of weight rows is applied to all samples before the
+ * next one is loaded, so the weights are read from memory once per batch.
+ */
+struct InnerProductTask
+{
+    const float *input;
+    const float *weights;
+    const float *bias;
+    float *output;
+    int inputs;
+    int outputs;
+    int batch;
+    bool relu;
+};
+
+/// Depth of the quantized products is padded with zeros to a multiple of this
+const int QUANTIZED_ALIGNMENT = 64;
+
+/// Largest quantized input, 7 bits keep the pairwise int16 sums of the byte products from saturating
+const int QUANTIZED_INPUT_MAX = 127;
+
+/// Largest magnitude of a quantized weight
+const int QUANTIZED_WEIGHT_MAX = 127;
+
+/**
+ * Products of int8 weight rows with unsigned 7-bit input columns.
+ *
+ * Both the rows and the columns are stored contiguously, with the depth
+ * padded to QUANTIZED_ALIGNMENT. The integer dot products are scaled back
+ * per row, output[row * outputstride + column * columnstride] =
+ * scales[row] * dot + bias[row].
+ */
+struct QuantizedTask
+{
+    const uint8_t *inputs;
+    const int8_t *weights;
+    const float *scales;
+    const float *bias;
+    float *output;
+    int rows;
+    int columns;
+    int depth;
+    int outputstride;
+    int columnstride;
+    bool relu;
+};
+
+/**
+ * Bilinear resize of a crop of a BGR image straight into the planar,
+ * mean-subtracted network input.
+ *
+ * The sampling positions are precomputed per output column and row, as
+ * size first samples followed by size second samples. The columns are byte
+ * offsets in the row with a weight for each of them - a sample in the black
+ * padding outside the image has weight 0 and any offset inside the row, so
+ * the columns are interpolated with vector gathers without branches. The
+ * rows are row indices (-1 for the padding) with the weight of the second
+ * one. Each output row is first interpolated horizontally into the scratch
+ * buffer (6 x size floats), then blended vertically into the three planes.
+ */
+struct CropResizeTask
+{
+    const uint8_t *image;
+    size_t step;
+    int height;
+    const int32_t *columns;
+    const float *columnweights;
+    const int *rows;
+    const float *rowweights;
+    const float *mean;
+    float *scratch;
+    float *output;
+    int size;
+};
+
+struct NativeKernels
+{
+    const char *name;
+
+    /// Number of output channels computed at once, used for packing the weights
+    int vectorwidth;
+
+    /// Number of work items of the convolution task
+    int (*convolutionItems)(const ConvolutionTask &task);
+
+    /// Computes the work items [begin, end) of the convolution task
+    void (*convolve)(const ConvolutionTask &task, int begin, int end);
+
+    /// Computes the outputs [begin, end) of the fully connected layer
+    void (*innerProduct)(const InnerProductTask &task, int begin, int end);
+
+    /// Computes the rows [begin, end) of the quantized products
+    void (*quantizedProduct)(const QuantizedTask &task, int begin, int end);
+
+    /// Computes the output rows [begin, end) of the crop
+    void (*cropResize)(const CropResizeTask &task, int begin, int end);
+};
+
+const NativeKernels &genericKernels();
+#ifdef NATIVE_HAVE_AVX2
+const NativeKernels &avx2Kernels();
+#endif
+#ifdef NATIVE_HAVE_AVX512
+const NativeKernels &avx512Kernels();
+#endif
+
+/**
+ * Returns the fastest kernels supported by the CPU.
+ *
+ * The NATIVE_KERNELS environment variable (generic, avx2, avx512) can be
+ * used to force the given kernels, e.g. for comparisons.
+ */
+const NativeKernels &selectNativeKernels();
+
+#endif
@@ -0,0 +1,635 @@
+#include "native-network.h"
+#include "low-rank-model.h"
+#include "network-input.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <opencv2/core/core.hpp>
+
+namespace
+{
+
+/// Topology of the convolution towers, identical for both inputs
+struct ConvolutionSpec
+{
+    const char *name;
+    int outputs;
+    int kernel;
+    int stride;
+    int pad;
+    int groups;
+};
+
+const ConvolutionSpec TOWER[5] = {
+    { "conv1", 96, 11, 4, 0, 1 },
+    { "conv2", 256, 5, 1, 2, 2 },
+    { "conv3", 384, 3, 1, 1, 1 },
+    { "conv4", 384, 3, 1, 1, 2 },
+    { "conv5", 256, 3, 1, 1, 2 }
+};
+
+const char *INNER_PRODUCTS[4] = { "fc6-new", "fc7-new", "fc7-newb", "fc8-shapes" };
+
+/// Output features of each tower, 256x6x6 after pool5
+const int TOWER_FEATURES = 256 * 6 * 6;
+
+/// Largest activation, the conv1 output of 96x55x55
+const int MAX_ACTIVATION = 96 * 55 * 55;
+
+/// Largest padded convolution input, the conv2 input of 96x31x31
+const int MAX_PADDED = 96 * 31 * 31;
+
+// local response normalization of norm1 and norm2, the power of 0.75 is computed with square roots
+const int LRN_SIZE = 5;
+const float LRN_ALPHA = 0.0001f;
+
+/// Largest normalized input, the norm1 input of 96x27x27
+const int MAX_NORMALIZED = 96 * 27 * 27;
+
+/// Largest normalized plane, the norm1 plane of 27x27
+const int MAX_NORMALIZED_PLANE = 27 * 27;
+
+class ConvolutionBody : public cv::ParallelLoopBody
+{
+public:
+    ConvolutionBody(const NativeKernels &kernels, const ConvolutionTask &task) : kernels(kernels), task(task) {}
+
+    void operator()(const cv::Range &range) const override
+    {
+        kernels.convolve(task, range.start, range.end);
+    }
+
+private:
+    const NativeKernels &kernels;
+    const ConvolutionTask &task;
+};
+
+class QuantizedBody : public cv::ParallelLoopBody
+{
+public:
+    /// Rows per stripe, sharing the cached input columns
+    static const int ROWS = 16;
+
+    QuantizedBody(const NativeKernels &kernels, const QuantizedTask &task) : kernels(kernels), task(task) {}
+
+    void operator()(const cv::Range &range) const override
+    {
+        kernels.quantizedProduct(task, range.start * ROWS, std::min(range.end * ROWS, task.rows));
+    }
+
+private:
+    const NativeKernels &kernels;
+    const QuantizedTask &task;
+};
+
+/// Gathers the quantized receptive fields of the output rows into columns, for the quantized convolution
+class ColumnsBody : public cv::ParallelLoopBody
+{
+public:
+    ColumnsBody(const NativeWeights::Convolution &layer, const uint8_t *input, int size, int outsize, uint8_t *columns)
+        : layer(layer), input(input), size(size), outsize(outsize), columns(columns)
+    {
+    }
+
+    /// The range is over the (group, output row) pairs
+    void operator()(const cv::Range &range) const override
+    {
+        const int K = layer.kernel;
+        const int channels = layer.inputs / layer.groups;
+        const int depth = layer.int8.depth;
+        for (int item = range.start; item < range.end; item++)
+        {
+            int group = item / outsize;
+            int y = item % outsize;
+            const uint8_t *planes = input + (size_t)group * channels * size * size;
+            for (int x = 0; x < outsize; x++)
+            {
+                // the padding stays zero, as the columns are cleared
+                uint8_t *column = columns + ((size_t)group * outsize * outsize + y * outsize + x) * depth;
+                for (int c = 0; c < channels; c++)
+                {
+                    const uint8_t *plane = planes + (size_t)c * size * size;
+                    for (int ky = 0; ky < K; ky++)
+                    {
+                        int iy = y * layer.stride + ky - layer.pad;
+                        if (iy < 0 || iy >= size) continue;
+                        for (int kx = 0; kx < K; kx++)
+                        {
+                            int ix = x * layer.stride + kx - layer.pad;
+                            if (ix >= 0 && ix < size) column[(c * K + ky) * K + kx] = plane[iy * size + ix];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    const NativeWeights::Convolution &layer;
+    const uint8_t *input;
+    int size;
+    int outsize;
+    uint8_t *columns;
+};
+
+class InnerProductBody : public cv::ParallelLoopBody
+{
+public:
+    /// Rows per stripe, a multiple of the 4 rows computed at once
+    static const int ROWS = 64;
+
+    InnerProductBody(const NativeKernels &kernels, const InnerProductTask &task) : kernels(kernels), task(task) {}
+
+    void operator()(const cv::Range &range) const override
+    {
+        kernels.innerProduct(task, range.start * ROWS, std::min(range.end * ROWS, task.outputs));
+    }
+
+private:
+    const NativeKernels &kernels;
+    const InnerProductTask &task;
+};
+
+/**
+ * Quantizes the rows x depth weights per row, into rows of the padded
+ * depth. Returns 0 on success, 1 if the layer is not calibrated.
+ */
+int quantizeWeights(const Int8Calibration &calibration, const std::string &name, const float *weights, int rows, int depth,
+    NativeWeights::Int8Weights &int8)
+{
+    float range = calibration.range(name);
+    if (range <= 0.0f)
+    {
+        printf("The int8 calibration has no range of the layer %s\n", name.c_str());
+        return 1;
+    }
+    int8.inputscale = range / QUANTIZED_INPUT_MAX;
+    int8.depth = (depth + QUANTIZED_ALIGNMENT - 1) / QUANTIZED_ALIGNMENT * QUANTIZED_ALIGNMENT;
+    int8.weights.assign((size_t)rows * int8.depth, 0);
+    int8.scales.resize(rows);
+    for (int row = 0; row < rows; row++)
+    {
+        const float *w = weights + (size_t)row * depth;
+        float largest = 0.0f;
+        for (int i = 0; i < depth; i++) largest = std::max(largest, std::abs(w[i]));
+        float scale = largest > 0.0f ? largest / QUANTIZED_WEIGHT_MAX : 1.0f;
+        int8_t *quantized = &int8.weights[(size_t)row * int8.depth];
+        for (int i = 0; i < depth; i++) quantized[i] = (int8_t)std::lround(w[i] / scale);
+        int8.scales[row] = scale * int8.inputscale;
+    }
+    return 0;
+}
+
+/// Quantizes the non-negative activations to the 7-bit inputs of the quantized products
+void quantizeInput(const float *input, size_t count, float scale, uint8_t *output)
+{
+    float inverse = 1.0f / scale;
+    for (size_t i = 0; i < count; i++)
+    {
+        float value = input[i] * inverse + 0.5f;
+        output[i] = value <= 0.0f ? 0 : value >= QUANTIZED_INPUT_MAX ? QUANTIZED_INPUT_MAX : (uint8_t)value;
+    }
+}
+
+/// 3x3 max pooling with stride 2, rounding the output size up like Caffe
+void maxPool(const float *input, int channels, int size, float *output)
+{
+    int outsize = (size - 3 + 1) / 2 + 1;
+    for (int c = 0; c < channels; c++)
+    {
+        const float *plane = input + c * size * size;
+        float *out = output + c * outsize * outsize;
+        for (int y = 0; y < outsize; y++)
+        {
+            int yend = std::min(y * 2 + 3, size);
+            for (int x = 0; x < outsize; x++)
+            {
+                int xend = std::min(x * 2 + 3, size);
+                float value = plane[y * 2 * size + x * 2];
+                for (int py = y * 2; py < yend; py++)
+                {
+                    for (int px = x * 2; px < xend; px++) value = std::max(value, plane[py * size + px]);
+                }
+                out[y * outsize + x] = value;
+            }
+        }
+    }
+}
+
+}
+
+int NativeWeights::loadConvolution(const CaffeWeights &model, const std::string &name, int tower, int index)
+{
+    const ConvolutionSpec &spec = TOWER[index];
+    CaffeWeights::const_iterator layer = model.find(name);
+    if (layer == model.end() || layer->second.size() != 2)
+    {
+        printf("The model has no weights of the layer %s\n", name.c_str());
+        return 1;
+    }
+    const CaffeBlob &weights = layer->second[0];
+    const CaffeBlob &bias = layer->second[1];
+    if (weights.shape.size() != 4 || weights.shape[0] != spec.outputs || weights.shape[2] != spec.kernel
+        || weights.shape[3] != spec.kernel || (int)bias.data.size() != spec.outputs)
+    {
+        printf("Unexpected shape of the layer %s\n", name.c_str());
+        return 1;
+    }
+
+    Convolution &convolution = towers[tower][index];
+    convolution.name = name;
+    convolution.outputs = spec.outputs;
+    convolution.inputs = weights.shape[1] * spec.groups;
+    convolution.kernel = spec.kernel;
+    convolution.stride = spec.stride;
+    convolution.pad = spec.pad;
+    convolution.groups = spec.groups;
+    convolution.bias = bias.data;
+    // the first convolution reads the mean-subtracted image, which is signed
+    convolution.quantizable = index > 0;
+
+    // repack [output][input][ky][kx] to [group][block][input][ky][kx][lane]
+    int width = kernels->vectorwidth;
+    int groupoutputs = spec.outputs / spec.groups;
+    int groupinputs = weights.shape[1];
+    int area = spec.kernel * spec.kernel;
+    if (groupoutputs % width != 0 || (int)weights.data.size() != spec.outputs * groupinputs * area)
+    {
+        printf("Unexpected shape of the layer %s\n", name.c_str());
+        return 1;
+    }
+    if (calibration && convolution.quantizable)
+    {
+        return quantizeWeights(*calibration, name, weights.data.data(), spec.outputs, groupinputs * area, convolution.int8);
+    }
+    convolution.weights.resize(weights.data.size());
+    for (int output = 0; output < spec.outputs; output++)
+    {
+        int block = output / width;
+        int lane = output % width;
+        for (int input = 0; input < groupinputs; input++)
+        {
+            for (int k = 0; k < area; k++)
+            {
+                size_t packed = ((size_t)(block * groupinputs + input) * area + k) * width + lane;
+                convolution.weights[packed] = weights.data[((size_t)output * groupinputs + input) * area + k];
+            }
+        }
+    }
+    return 0;
+}
+
+int NativeWeights::loadProjection(const CaffeWeights &model, const std::string &name, int index, int inputs)
+{
+    CaffeWeights::const_iterator layer = model.find(name);
+    InnerProduct &projection = projections[index];
+    projection.name = name;
+    projection.inputs = inputs;
+    projection.outputs = 0;
+    if (layer == model.end()) return 0;
+
+    const CaffeBlob &weights = layer->second[0];
+    if (layer->second.size() != 1 || weights.shape.size() != 2 || weights.shape[1] != inputs
+        || weights.data.size() != (size_t)weights.shape[0] * inputs)
+    {
+        printf("Unexpected shape of the layer %s\n", name.c_str());
+        return 1;
+    }
+    projection.outputs = weights.shape[0];
+    projection.bias.assign(projection.outputs, 0.0f);
+    // the inner products read the ReLU outputs, only the last one is kept in fp32
+    projection.quantizable = index < 3;
+    if (calibration && projection.quantizable)
+    {
+        return quantizeWeights(*calibration, name, weights.data.data(), projection.outputs, inputs, projection.int8);
+    }
+    projection.weights = weights.data;
+    return 0;
+}
+
+int NativeWeights::loadInnerProduct(const CaffeWeights &model, const std::string &name, int index)
+{
+    CaffeWeights::const_iterator layer = model.find(name);
+    if (layer == model.end() || layer->second.size() != 2)
+    {
+        printf("The model has no weights of the layer %s\n", name.c_str());
+        return 1;
+    }
+    int expected = index == 0 ? 2 * TOWER_FEATURES : fullyconnected[index - 1].outputs;
+    // a low-rank layer reads the output of its projection
+    if (loadProjection(model, name + LOW_RANK_SUFFIX, index, expected) != 0) return 1;
+    if (projections[index].outputs > 0) expected = projections[index].outputs;
+
+    InnerProduct &innerproduct = fullyconnected[index];
+    innerproduct.name = name;
+    innerproduct.bias = layer->second[1].data;
+    innerproduct.outputs = innerproduct.bias.size();
+    const std::vector<float> &weights = layer->second[0].data;
+    if (innerproduct.outputs == 0 || weights.size() != (size_t)innerproduct.outputs * expected)
+    {
+        printf("Unexpected shape of the layer %s\n", name.c_str());
+        return 1;
+    }
+    innerproduct.inputs = expected;
+    // the output of a projection is signed
+    innerproduct.quantizable = index < 3 && projections[index].outputs == 0;
+    if (calibration && innerproduct.quantizable)
+    {
+        return quantizeWeights(*calibration, name, weights.data(), innerproduct.outputs, expected, innerproduct.int8);
+    }
+    innerproduct.weights = weights;
+    return 0;
+}
+
+std::shared_ptr<const NativeWeights> NativeWeights::load(const std::string &caffemodel, const Int8Calibration *calibration)
+{
+    CaffeWeights model;
+    if (readCaffemodel(caffemodel, model) != 0) return nullptr;
+
+    std::shared_ptr<NativeWeights> weights(new NativeWeights());
+    weights->kernels = &selectNativeKernels();
+    weights->quantized = calibration != nullptr;
+    weights->calibration = calibration;
+    for (int index = 0; index < 5; index++)
+    {
+        std::string name = TOWER[index].name;
+        if (weights->loadConvolution(model, name, 0, index) != 0) return nullptr;
+        if (weights->loadConvolution(model, name + "_p", 1, index) != 0) return nullptr;
+    }
+    for (int index = 0; index < 4; index++)
+    {
+        if (weights->loadInnerProduct(model, INNER_PRODUCTS[index], index) != 0) return nullptr;
+    }
+    if (weights->fullyconnected[3].outputs != 4)
+    {
+        printf("Unexpected number of outputs of the model\n");
+        return nullptr;
+    }
+    weights->calibration = nullptr;
+    printf("Loaded native network weights, using %s kernels%s\n", weights->kernels->name, weights->quantized ? " in int8" : "");
+    return weights;
+}
+
+NativeNetwork::NativeNetwork(std::shared_ptr<const NativeWeights> weights)
+    : weights(weights),
+      padded(MAX_PADDED),
+      first(MAX_ACTIVATION),
+      second(MAX_ACTIVATION),
+      squares(MAX_NORMALIZED),
+      windowsum(MAX_NORMALIZED_PLANE),
+      calibration(nullptr)
+{
+    rank = 0;
+    for (const NativeWeights::InnerProduct &projection : weights->projections) rank = std::max(rank, projection.outputs);
+}
+
+void NativeNetwork::setCalibration(Int8Calibration *calibration)
+{
+    this->calibration = calibration;
+}
+
+std::shared_ptr<const NativeWeights> NativeNetwork::sharedWeights() const
+{
+    return weights;
+}
+
+void NativeNetwork::convolution(const NativeWeights::Convolution &layer, const float *input, int size, float *output)
+{
+    if (calibration && layer.quantizable) calibration->observe(layer.name, input, (size_t)layer.inputs * size * size);
+    if (!layer.int8.weights.empty())
+    {
+        quantizedConvolution(layer, input, size, output);
+        return;
+    }
+
+    int paddedsize = size + 2 * layer.pad;
+    if (layer.pad > 0)
+    {
+        padded.assign((size_t)layer.inputs * paddedsize * paddedsize, 0.0f);
+        for (int c = 0; c < layer.inputs; c++)
+        {
+            for (int y = 0; y < size; y++)
+            {
+                memcpy(&padded[((size_t)c * paddedsize + y + layer.pad) * paddedsize + layer.pad],
+                    input + ((size_t)c * size + y) * size, size * sizeof(float));
+            }
+        }
+        input = padded.data();
+    }
+
+    int outsize = (paddedsize - layer.kernel) / layer.stride + 1;
+    ConvolutionTask task = {
+        input, paddedsize, paddedsize,
+        layer.weights.data(), layer.bias.data(), output,
+        layer.inputs, layer.outputs, outsize, outsize,
+        layer.kernel, layer.stride, layer.groups, true
+    };
+    const NativeKernels &kernels = *weights->kernels;
+    cv::parallel_for_(cv::Range(0, kernels.convolutionItems(task)), ConvolutionBody(kernels, task));
+}
+
+void NativeNetwork::quantizedConvolution(const NativeWeights::Convolution &layer, const float *input, int size, float *output)
+{
+    const NativeWeights::Int8Weights &int8 = layer.int8;
+    int outsize = (size + 2 * layer.pad - layer.kernel) / layer.stride + 1;
+    int pixels = outsize * outsize;
+    int groupoutputs = layer.outputs / layer.groups;
+
+    quantized.resize((size_t)layer.inputs * size * size);
+    quantizeInput(input, quantized.size(), int8.inputscale, quantized.data());
+    columns.assign((size_t)layer.groups * pixels * int8.depth, 0);
+    cv::parallel_for_(cv::Range(0, layer.groups * outsize), ColumnsBody(layer, quantized.data(), size, outsize, columns.data()));
+
+    const NativeKernels &kernels = *weights->kernels;
+    int stripes = (groupoutputs + QuantizedBody::ROWS - 1) / QuantizedBody::ROWS;
+    for (int group = 0; group < layer.groups; group++)
+    {
+        QuantizedTask task = {
+            columns.data() + (size_t)group * pixels * int8.depth,
+            int8.weights.data() + (size_t)group * groupoutputs * int8.depth,
+            int8.scales.data() + group * groupoutputs,
+            layer.bias.data() + group * groupoutputs,
+            output + (size_t)group * groupoutputs * pixels,
+            groupoutputs, pixels, int8.depth, pixels, 1, true
+        };
+        cv::parallel_for_(cv::Range(0, stripes), QuantizedBody(kernels, task));
+    }
+}
+
+void NativeNetwork::innerProduct(const NativeWeights::InnerProduct &layer, int count, const float *input, float *output, bool relu)
+{
+    if (calibration && layer.quantizable) calibration->observe(layer.name, input, (size_t)count * layer.inputs);
+    if (!layer.int8.weights.empty())
+    {
+        // the samples are the columns of the quantized product
+        const NativeWeights::Int8Weights &int8 = layer.int8;
+        quantized.assign((size_t)count * int8.depth, 0);
+        for (int sample = 0; sample < count; sample++)
+        {
+            quantizeInput(input + (size_t)sample * layer.inputs, layer.inputs, int8.inputscale,
+                quantized.data() + (size_t)sample * int8.depth);
+        }
+        QuantizedTask task = {
+            quantized.data(), int8.weights.data(), int8.scales.data(), layer.bias.data(), output,
+            layer.outputs, count, int8.depth, 1, layer.outputs, relu
+        };
+        int stripes = (layer.outputs + QuantizedBody::ROWS - 1) / QuantizedBody::ROWS;
+        cv::parallel_for_(cv::Range(0, stripes), QuantizedBody(*weights->kernels, task));
+        return;
+    }
+
+    InnerProductTask task = {
+        input, layer.weights.data(), layer.bias.data(), output,
+        layer.inputs, layer.outputs, count, relu
+    };
+    int stripes = (layer.outputs + InnerProductBody::ROWS - 1) / InnerProductBody::ROWS;
+    cv::parallel_for_(cv::Range(0, stripes), InnerProductBody(*weights->kernels, task));
+}
+
+void NativeNetwork::fullyConnected(int index, int count, const float *input, float *output, bool relu)
+{
+    const NativeWeights::InnerProduct &projection = weights->projections[index];
+    if (projection.outputs > 0)
+    {
+        innerProduct(projection, count, input, projected.data(), false);
+        input = projected.data();
+    }
+    innerProduct(weights->fullyconnected[index], count, input, output, relu);
+}
+
+/// Local response normalization across channels, the window sum slides over the channels
+void NativeNetwork::normalize(const float *input, int channels, int size, float *output)
+{
+    const int planesize = size * size;
+    float *squares = this->squares.data();
+    float *sum = windowsum.data();
+    for (int i = 0; i < planesize * channels; i++) squares[i] = input[i] * input[i];
+
+    std::fill(sum, sum + planesize, 0.0f);
+    for (int n = 0; n < std::min(channels, LRN_SIZE / 2); n++)
+    {
+        for (int i = 0; i < planesize; i++) sum[i] += squares[n * planesize + i];
+    }
+    for (int c = 0; c < channels; c++)
+    {
+        int head = c + LRN_SIZE / 2;
+        int tail = c - LRN_SIZE / 2 - 1;
+        if (head < channels)
+        {
+            for (int i = 0; i < planesize; i++) sum[i] += squares[head * planesize + i];
+        }
+        if (tail >= 0)
+        {
+            for (int i = 0; i < planesize; i++) sum[i] -= squares[tail * planesize + i];
+        }
+        const float *in = input + c * planesize;
+        float *out = output + c * planesize;
+        for (int i = 0; i < planesize; i++)
+        {
+            float root = std::sqrt(1.0f + LRN_ALPHA / LRN_SIZE * sum[i]);
+            out[i] = in[i] / (root * std::sqrt(root));
+        }
+    }
+}
+
+void NativeNetwork::tower(int index, const float *input, float *output)
+{
+    const NativeWeights::Convolution *layers = weights->towers[index];
+    float *a = first.data();
+    float *b = second.data();
+
+    convolution(layers[0], input, NETWORK_INPUT_SIZE, a);    // 96x55x55
+    maxPool(a, 96, 55, b);                                  // 96x27x27
+    normalize(b, 96, 27, a);
+    convolution(layers[1], a, 27, b);                       // 256x27x27
+    maxPool(b, 256, 27, a);                                 // 256x13x13
+    normalize(a, 256, 13, b);
+    convolution(layers[2], b, 13, a);                       // 384x13x13
+    convolution(layers[3], a, 13, b);                       // 384x13x13
+    convolution(layers[4], b, 13, a);                       // 256x13x13
+    maxPool(a, 256, 13, output);                            // 256x6x6
+}
+
+void NativeNetwork::forward(const float *target, const float *image, float output[4])
+{
+    forward(1, &target, &image, output);
+}
+
+void NativeNetwork::forward(int count, const float *const *targets, const float *const *images, float *outputs)
+{
+    // the buffers grow to the largest batch seen
+    const NativeWeights &w = *weights;
+    features.resize((size_t)count * 2 * TOWER_FEATURES);
+    hidden[0].resize((size_t)count * std::max(w.fullyconnected[0].outputs, w.fullyconnected[2].outputs));
+    hidden[1].resize((size_t)count * w.fullyconnected[1].outputs);
+    projected.resize((size_t)count * rank);
+
+    // the concatenation of the towers is the input of fc6
+    for (int sample = 0; sample < count; sample++)
+    {
+        float *concatenated = features.data() + (size_t)sample * 2 * TOWER_FEATURES;
+        tower(0, targets[sample], concatenated);
+        tower(1, images[sample], concatenated + TOWER_FEATURES);
+    }
+
+    fullyConnected(0, count, features.data(), hidden[0].data(), true);
+    fullyConnected(1, count, hidden[0].data(), hidden[1].data(), true);
+    fullyConnected(2, count, hidden[1].data(), hidden[0].data(), true);
+    fullyConnected(3, count, hidden[0].data(), outputs, false);
+}
+
+NativeRegressor::NativeRegressor(std::shared_ptr<const NativeWeights> weights)
+    : network(weights)
+{
+}
+
+void NativeRegressor::setCalibration(Int8Calibration *calibration)
+{
+    network.setCalibration(calibration);
+}
+
+std::shared_ptr<const NativeWeights> NativeRegressor::sharedWeights() const
+{
+    return network.sharedWeights();
+}
+
+void NativeRegressor::regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate)
+{
+    std::vector<BoundingBox> estimates;
+    regressBatch(std::vector<cv::Mat>(1, target), std::vector<cv::Mat>(1, search), estimates);
+    estimate = estimates[0];
+}
+
+void NativeRegressor::regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    int count = targets.size();
+    if (targetinputs.size() < targets.size())
+    {
+        targetinputs.resize(count, std::vector<float>(NETWORK_INPUT_VALUES));
+        imageinputs.resize(count, std::vector<float>(NETWORK_INPUT_VALUES));
+    }
+    std::vector<const float *> targetpointers, imagepointers;
+    for (int i = 0; i < count; i++)
+    {
+        preprocessCrop(targets[i], targetinputs[i].data());
+        preprocessCrop(searches[i], imageinputs[i].data());
+        targetpointers.push_back(targetinputs[i].data());
+        imagepointers.push_back(imageinputs[i].data());
+    }
+    regressInputs(targetpointers, imagepointers, estimates);
+}
+
+void NativeRegressor::regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+    std::vector<BoundingBox> &estimates)
+{
+    int count = targets.size();
+    std::vector<float> outputs(4 * count);
+    network.forward(count, targets.data(), searches.data(), outputs.data());
+    estimates.clear();
+    for (int i = 0; i < count; i++)
+    {
+        estimates.push_back(BoundingBox(std::vector<float>(&outputs[4 * i], &outputs[4 * i] + 4)));
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef NATIVE_NETWORK_H
+#define NATIVE_NETWORK_H
+
+#include "box-regressor.h"
+#include "caffemodel-reader.h"
+#include "int8-calibration.h"
+#include "native-kernels.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Weights of the GOTURN network, packed for the selected kernels.
+ *
+ * Immutable once loaded, so a single instance can be shared by any number
+ * of networks running in parallel. With a calibration, the layers reading
+ * non-negative activations (all but the first convolution and the last
+ * inner product) are quantized to int8 and run with integer products.
+ */
+class NativeWeights
+{
+public:
+    /// Weights quantized per output channel, replacing the fp32 weights
+    struct Int8Weights
+    {
+        /// Rows of the padded depth, the rows of each convolution group are consecutive
+        std::vector<int8_t> weights;
+        /// Weight scale times the input scale, per output
+        std::vector<float> scales;
+        float inputscale = 0.0f;
+        int depth = 0;
+    };
+
+    struct Convolution
+    {
+        std::string name;
+        int inputs;
+        int outputs;
+        int kernel;
+        int stride;
+        int pad;
+        int groups;
+        std::vector<float> weights;
+        std::vector<float> bias;
+        /// Set for the layers reading non-negative inputs, which can run in int8
+        bool quantizable;
+        Int8Weights int8;
+    };
+
+    struct InnerProduct
+    {
+        std::string name;
+        int inputs;
+        int outputs;
+        std::vector<float> weights;
+        std::vector<float> bias;
+        bool quantizable;
+        Int8Weights int8;
+    };
+
+    /// Convolutions of the target (0) and image (1) towers
+    Convolution towers[2][5];
+    InnerProduct fullyconnected[4];
+    /// Input projections of the low-rank fully connected layers, without outputs for the full-rank ones
+    InnerProduct projections[4];
+    const NativeKernels *kernels;
+    bool quantized;
+
+    /**
+     * Loads the weights from the .caffemodel, quantizing them if the
+     * calibration is given. Returns null on failure.
+     */
+    static std::shared_ptr<const NativeWeights> load(const std::string &caffemodel, const Int8Calibration *calibration = nullptr);
+
+private:
+    int loadConvolution(const CaffeWeights &model, const std::string &name, int tower, int index);
+    int loadInnerProduct(const CaffeWeights &model, const std::string &name, int index);
+    int loadProjection(const CaffeWeights &model, const std::string &name, int index, int inputs);
+
+    const Int8Calibration *calibration;
+};
+
+/**
+ * CPU implementation of the GOTURN forward pass.
+ *
+ * Runs the two convolution towers with direct convolutions and the fully
+ * connected head with matrix products over the batch, all on preallocated
+ * buffers. An instance is not thread-safe, use one per thread.
+ */
+class NativeNetwork
+{
+public:
+    explicit NativeNetwork(std::shared_ptr<const NativeWeights> weights);
+
+    /**
+     * Computes the box estimate from the planar, mean-subtracted 3x227x227
+     * target and image inputs.
+     */
+    void forward(const float *target, const float *image, float output[4]);
+
+    /**
+     * Computes the box estimates of count target and image pairs, 4 values
+     * per pair in outputs. The towers run per pair, while the weights of
+     * the fully connected layers are streamed once for the whole batch.
+     */
+    void forward(int count, const float *const *targets, const float *const *images, float *outputs);
+
+    /// Records the inputs of the quantizable layers in the calibration during forward passes, null stops
+    void setCalibration(Int8Calibration *calibration);
+
+    std::shared_ptr<const NativeWeights> sharedWeights() const;
+
+private:
+    void tower(int index, const float *input, float *features);
+    void convolution(const NativeWeights::Convolution &layer, const float *input, int size, float *output);
+    void quantizedConvolution(const NativeWeights::Convolution &layer, const float *input, int size, float *output);
+    void innerProduct(const NativeWeights::InnerProduct &layer, int count, const float *input, float *output, bool relu);
+    void fullyConnected(int index, int count, const float *input, float *output, bool relu);
+    void normalize(const float *input, int channels, int size, float *output);
+
+    std::shared_ptr<const NativeWeights> weights;
+    std::vector<float> padded;
+    std::vector<float> first;
+    std::vector<float> second;
+    /// Squares of the normalized input and their sums over the window of the current channel
+    std::vector<float> squares;
+    std::vector<float> windowsum;
+    std::vector<float> features;
+    std::vector<float> hidden[2];
+    std::vector<float> projected;
+    /// Largest rank of the projections
+    int rank;
+    std::vector<uint8_t> quantized;
+    std::vector<uint8_t> columns;
+    Int8Calibration *calibration;
+};
+
+/**
+ * Regressor running the native network.
+ */
+class NativeRegressor : public BoxRegressor
+{
+public:
+    explicit NativeRegressor(std::shared_ptr<const NativeWeights> weights);
+
+    void regress(const cv::Mat &target, const cv::Mat &search, BoundingBox &estimate) override;
+
+    void regressBatch(const std::vector<cv::Mat> &targets, const std::vector<cv::Mat> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+    /// The inputs are passed to the network as they are
+    void regressInputs(const std::vector<const float *> &targets, const std::vector<const float *> &searches,
+        std::vector<BoundingBox> &estimates) override;
+
+    /// Weights of the network, for more regressors sharing them
+    std::shared_ptr<const NativeWeights> sharedWeights() const;
+
+    /// Records the activation ranges of the network in the calibration, null stops
+    void setCalibration(Int8Calibration *calibration);
+
+private:
+    NativeNetwork network;
+    std::vector<std::vector<float>> targetinputs;
+    std::vector<std::vector<float>> imageinputs;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "network-input.h"
+#include "native-kernels.h"
+#include "helper/image_proc.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+/**
+ * Computes the bilinear sampling of the resize from length pixels of the
+ * padded crop to NETWORK_INPUT_SIZE, like cv::resize (pixel centers aligned,
+ * edge pixels replicated). The padded crop pixels [first, first + count) are
+ * the image pixels from offset on, the others are the padding (-1). The
+ * source pixels are multiplied by stride. The first samples of all pixels
+ * are followed by the second ones.
+ */
+void sampleAxis(int length, int first, int count, int offset, int stride, int *sources, float *weights)
+{
+    double scale = (double)length / NETWORK_INPUT_SIZE;
+    for (int i = 0; i < NETWORK_INPUT_SIZE; i++)
+    {
+        double position = (i + 0.5) * scale - 0.5;
+        int left = (int)std::floor(position);
+        double weight = position - left;
+        if (left < 0)
+        {
+            left = 0;
+            weight = 0;
+        }
+        if (left >= length - 1)
+        {
+            left = length - 1;
+            weight = 0;
+        }
+        int right = std::min(left + 1, length - 1);
+        sources[i] = left >= first && left < first + count ? (left - first + offset) * stride : -1;
+        sources[NETWORK_INPUT_SIZE + i] = right >= first && right < first + count ? (right - first + offset) * stride : -1;
+        weights[i] = weight;
+    }
+}
+
+/// Splits the weight of the column samples between both of them, the padding gets weight 0 at offset 0
+void weighColumns(const int *sources, const float *weights, int32_t *columns, float *columnweights)
+{
+    for (int i = 0; i < NETWORK_INPUT_SIZE; i++)
+    {
+        int left = sources[i];
+        int right = sources[NETWORK_INPUT_SIZE + i];
+        columns[i] = std::max(left, 0);
+        columns[NETWORK_INPUT_SIZE + i] = std::max(right, 0);
+        columnweights[i] = left >= 0 ? 1.0f - weights[i] : 0.0f;
+        columnweights[NETWORK_INPUT_SIZE + i] = right >= 0 ? weights[i] : 0.0f;
+    }
+}
+
+}
+
+void preprocessCrop(const cv::Mat &crop, float *input)
+{
+    cv::Mat resized;
+    if (crop.cols != NETWORK_INPUT_SIZE || crop.rows != NETWORK_INPUT_SIZE)
+    {
+        cv::resize(crop, resized, cv::Size(NETWORK_INPUT_SIZE, NETWORK_INPUT_SIZE));
+    }
+    else
+    {
+        resized = crop;
+    }
+    cv::Mat converted;
+    resized.convertTo(converted, CV_32FC3);
+
+    // split straight into the planar input
+    std::vector<cv::Mat> planes;
+    for (int c = 0; c < 3; c++)
+    {
+        planes.push_back(cv::Mat(NETWORK_INPUT_SIZE, NETWORK_INPUT_SIZE, CV_32FC1, input + c * NETWORK_INPUT_SIZE * NETWORK_INPUT_SIZE));
+    }
+    cv::split(converted, planes);
+    for (int c = 0; c < 3; c++) cv::subtract(planes[c], cv::Scalar(NETWORK_MEAN[c]), planes[c]);
+}
+
+void cropNetworkInput(const cv::Mat &image, const BoundingBox &bbox, float *input, CropPlacement &placement)
+{
+    if (image.type() != CV_8UC3)
+    {
+        cv::Mat crop;
+        CropPadImage(bbox, image, &crop, &placement.location, &placement.edgex, &placement.edgey);
+        placement.size = crop.size();
+        preprocessCrop(crop, input);
+        return;
+    }
+
+    // the same placement as in CropPadImage, including its truncations
+    ComputeCropPadImageLocation(bbox, image, &placement.location);
+    const BoundingBox &location = placement.location;
+    int roileft = std::min(location.x1_, (double)(image.cols - 1));
+    int roitop = std::min(location.y1_, (double)(image.rows - 1));
+    int roiwidth = std::min((double)image.cols, std::max(1.0, std::ceil(location.x2_ - location.x1_)));
+    int roiheight = std::min((double)image.rows, std::max(1.0, std::ceil(location.y2_ - location.y1_)));
+    placement.size.width = std::max(std::ceil(bbox.compute_output_width()), (double)roiwidth);
+    placement.size.height = std::max(std::ceil(bbox.compute_output_height()), (double)roiheight);
+    placement.edgex = std::min(bbox.edge_spacing_x(), (double)(placement.size.width - 1));
+    placement.edgey = std::min(bbox.edge_spacing_y(), (double)(placement.size.height - 1));
+
+    int samples[2 * NETWORK_INPUT_SIZE];
+    float sampleweights[NETWORK_INPUT_SIZE];
+    int32_t columns[2 * NETWORK_INPUT_SIZE];
+    float columnweights[2 * NETWORK_INPUT_SIZE];
+    int rows[2 * NETWORK_INPUT_SIZE];
+    float rowweights[NETWORK_INPUT_SIZE];
+    float scratch[6 * NETWORK_INPUT_SIZE];
+    sampleAxis(placement.size.width, (int)placement.edgex, roiwidth, roileft, 3, samples, sampleweights);
+    weighColumns(samples, sampleweights, columns, columnweights);
+    sampleAxis(placement.size.height, (int)placement.edgey, roiheight, roitop, 1, rows, rowweights);
+
+    static const NativeKernels &kernels = selectNativeKernels();
+    CropResizeTask task;
+    task.image = image.data;
+    task.step = image.step;
+    task.height = image.rows;
+    task.columns = columns;
+    task.columnweights = columnweights;
+    task.rows = rows;
+    task.rowweights = rowweights;
+    task.mean = NETWORK_MEAN;
+    task.scratch = scratch;
+    task.output = input;
+    task.size = NETWORK_INPUT_SIZE;
+    kernels.cropResize(task, 0, NETWORK_INPUT_SIZE);
+}
+
+cv::Mat networkInputImage(const float *input)
+{
+    std::vector<cv::Mat> planes;
+    for (int c = 0; c < 3; c++)
+    {
+        cv::Mat plane(NETWORK_INPUT_SIZE, NETWORK_INPUT_SIZE, CV_32FC1, const_cast<float *>(input) + c * NETWORK_INPUT_SIZE * NETWORK_INPUT_SIZE);
+        planes.push_back(plane + NETWORK_MEAN[c]);
+    }
+    cv::Mat image;
+    cv::merge(planes, image);
+    return image;
+}
+
+void uncropEstimate(const cv::Mat &image, const CropPlacement &placement, const BoundingBox &estimate, BoundingBox &bbox)
+{
+    // BoundingBox::Unscale, with the size of the crop that is never created
+    BoundingBox unscaled = estimate;
+    unscaled.x1_ = estimate.x1_ / estimate.scale_factor_ * placement.size.width;
+    unscaled.x2_ = estimate.x2_ / estimate.scale_factor_ * placement.size.width;
+    unscaled.y1_ = estimate.y1_ / estimate.scale_factor_ * placement.size.height;
+    unscaled.y2_ = estimate.y2_ / estimate.scale_factor_ * placement.size.height;
+    unscaled.Uncenter(image, placement.location, placement.edgex, placement.edgey, &bbox);
+}
@@ -0,0 +1,44 @@
+#ifndef NETWORK_INPUT_H
+#define NETWORK_INPUT_H
+
+#include "box-regressor.h"
+#include "helper/bounding_box.h"
+#include <opencv2/core/core.hpp>
+
+/**
+ * Placement of GOTURN's padded crop around a box, as computed by
+ * CropPadImage - the location of the crop in the image, the padding
+ * before it and the size of the padded crop.
+ */
+struct CropPlacement
+{
+    BoundingBox location;
+    double edgex;
+    double edgey;
+    cv::Size size;
+};
+
+/**
+ * Converts the crop to the network input - resized to the network input
+ * size, planar (3 x size x size) and mean-subtracted, like GOTURN's
+ * Regressor does.
+ */
+void preprocessCrop(const cv::Mat &crop, float *input);
+
+/**
+ * Writes the network input of GOTURN's padded crop of the box straight from
+ * the BGR image, without the intermediate crops.
+ *
+ * Equivalent to CropPadImage followed by preprocessCrop(), except that the
+ * values are not rounded to 8 bits after resizing. The placement is used
+ * for mapping the network estimate back to the image.
+ */
+void cropNetworkInput(const cv::Mat &image, const BoundingBox &bbox, float *input, CropPlacement &placement);
+
+/// Returns the image with the mean added back to the network input, as CV_32FC3
+cv::Mat networkInputImage(const float *input);
+
+/// Maps the network estimate in the placed crop to the image coordinates
+void uncropEstimate(const cv::Mat &image, const CropPlacement &placement, const BoundingBox &estimate, BoundingBox &bbox);
+
+#endif
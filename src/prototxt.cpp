@@ -0,0 +1,227 @@
+#include "prototxt.h"
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+class PrototxtParser
+{
+public:
+    explicit PrototxtParser(const std::string &text) : text(text), position(0), line(1) {}
+
+    /// Parses the fields up to the end of the text, or the closing brace if nested
+    bool parseFields(PrototxtNode &node, bool nested)
+    {
+        while (true)
+        {
+            skipSpace();
+            if (position >= text.size())
+            {
+                if (nested) return fail("unexpected end of the file");
+                return true;
+            }
+            if (text[position] == '}' || text[position] == '>')
+            {
+                if (!nested) return fail("unexpected closing brace");
+                position++;
+                return true;
+            }
+
+            PrototxtNode field;
+            size_t start = position;
+            while (position < text.size() && (isalnum((unsigned char)text[position]) || text[position] == '_'))
+            {
+                position++;
+            }
+            if (position == start) return fail("expected a field name");
+            field.name = text.substr(start, position - start);
+
+            skipSpace();
+            bool colon = position < text.size() && text[position] == ':';
+            if (colon)
+            {
+                position++;
+                skipSpace();
+            }
+            if (position < text.size() && (text[position] == '{' || text[position] == '<'))
+            {
+                position++;
+                field.message = true;
+                if (!parseFields(field, true)) return false;
+            }
+            else
+            {
+                if (!colon) return fail("expected a colon after " + field.name);
+                if (!parseValue(field.value)) return false;
+            }
+            node.children.push_back(field);
+
+            skipSpace();
+            if (position < text.size() && (text[position] == ';' || text[position] == ',')) position++;
+        }
+    }
+
+private:
+    bool parseValue(std::string &value)
+    {
+        if (position >= text.size()) return fail("expected a value");
+        size_t start = position;
+        char quote = text[position];
+        if (quote == '"' || quote == '\'')
+        {
+            position++;
+            while (position < text.size() && text[position] != quote)
+            {
+                if (text[position] == '\n') return fail("unterminated string");
+                if (text[position] == '\\') position++;
+                position++;
+            }
+            if (position >= text.size()) return fail("unterminated string");
+            position++;
+        }
+        else
+        {
+            while (position < text.size() && !isspace((unsigned char)text[position])
+                && text[position] != '}' && text[position] != '>' && text[position] != '#'
+                && text[position] != ';' && text[position] != ',')
+            {
+                position++;
+            }
+            if (position == start) return fail("expected a value");
+        }
+        value = text.substr(start, position - start);
+        return true;
+    }
+
+    void skipSpace()
+    {
+        while (position < text.size())
+        {
+            if (text[position] == '#')
+            {
+                while (position < text.size() && text[position] != '\n') position++;
+            }
+            else if (isspace((unsigned char)text[position]))
+            {
+                if (text[position] == '\n') line++;
+                position++;
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    bool fail(const std::string &message)
+    {
+        printf("Invalid network definition at line %d:  %s\n", line, message.c_str());
+        return false;
+    }
+
+    const std::string &text;
+    size_t position;
+    int line;
+};
+
+void writeFields(const PrototxtNode &node, int depth, std::string &out)
+{
+    std::string indent(depth * 2, ' ');
+    for (const PrototxtNode &field : node.children)
+    {
+        if (field.message)
+        {
+            out += indent + field.name + " {\n";
+            writeFields(field, depth + 1, out);
+            out += indent + "}\n";
+        }
+        else
+        {
+            out += indent + field.name + ": " + field.value + "\n";
+        }
+    }
+}
+
+}
+
+std::vector<std::string> PrototxtNode::strings(const std::string &field) const
+{
+    std::vector<std::string> values;
+    for (const PrototxtNode &child : children)
+    {
+        if (!child.message && child.name == field) values.push_back(unquotePrototxt(child.value));
+    }
+    return values;
+}
+
+std::string PrototxtNode::string(const std::string &field) const
+{
+    for (const PrototxtNode &child : children)
+    {
+        if (!child.message && child.name == field) return unquotePrototxt(child.value);
+    }
+    return "";
+}
+
+int parsePrototxt(const std::string &text, PrototxtNode &root)
+{
+    root = PrototxtNode();
+    root.message = true;
+    PrototxtParser parser(text);
+    return parser.parseFields(root, false) ? 0 : 1;
+}
+
+int readPrototxt(const std::string &filename, PrototxtNode &root)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        printf("Unable to open the network definition:  %s\n", filename.c_str());
+        return 1;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parsePrototxt(text.str(), root);
+}
+
+std::string writePrototxt(const PrototxtNode &root)
+{
+    std::string out;
+    writeFields(root, 0, out);
+    return out;
+}
+
+std::string quotePrototxt(const std::string &value)
+{
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+std::string unquotePrototxt(const std::string &value)
+{
+    if (value.size() < 2 || (value[0] != '"' && value[0] != '\'')) return value;
+    std::string result;
+    for (size_t i = 1; i + 1 < value.size(); i++)
+    {
+        if (value[i] == '\\' && i + 2 < value.size())
+        {
+            i++;
+            if (value[i] == 'n') result += '\n';
+            else if (value[i] == 't') result += '\t';
+            else result += value[i];
+        }
+        else
+        {
+            result += value[i];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef PROTOTXT_H
+#define PROTOTXT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Field of a message in the protobuf text format, as used by the Caffe
+ * network definitions.
+ *
+ * The fields keep their order and the scalar values are kept verbatim, so
+ * the definition can be edited and written back without Caffe or protobuf.
+ */
+struct PrototxtNode
+{
+    std::string name;
+
+    /// Verbatim scalar value (strings with their quotes), empty for messages
+    std::string value;
+
+    bool message = false;
+
+    /// Fields of the message
+    std::vector<PrototxtNode> children;
+
+    /// Returns the unquoted values of the scalar fields with the name
+    std::vector<std::string> strings(const std::string &field) const;
+
+    /// Returns the unquoted value of the first field with the name, or an empty string
+    std::string string(const std::string &field) const;
+};
+
+/// Parses the text of a network definition into root, returns 0 on success
+int parsePrototxt(const std::string &text, PrototxtNode &root);
+
+/// Reads and parses the network definition file, returns 0 on success
+int readPrototxt(const std::string &filename, PrototxtNode &root);
+
+/// Writes the fields of root in the text format
+std::string writePrototxt(const PrototxtNode &root);
+
+/// Returns the string as a quoted scalar value
+std::string quotePrototxt(const std::string &value);
+
+/// Returns the string of a quoted scalar value, other values are returned as is
+std::string unquotePrototxt(const std::string &value);
+
+#endif
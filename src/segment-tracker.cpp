@@ -0,0 +1,199 @@
+#include "segment-tracker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+
+/// Tracks reaching their keyframe with a lower overlap are considered lost
+const double MIN_TRACK_CONFIDENCE = 0.3;
+
+/// Confidence added to both tracks, so a track still counts near its own keyframe
+const double CONFIDENCE_FLOOR = 0.1;
+
+bool isEmpty(const BoundingBox &box)
+{
+    return box.x1_ == 0 && box.y1_ == 0 && box.x2_ == 0 && box.y2_ == 0;
+}
+
+/**
+ * Runs the jobs [0, count) on one worker thread per backend, each worker
+ * taking the next job when it finishes the previous one. Returns false if
+ * any job failed, the remaining jobs are skipped then.
+ */
+bool runWorkers(size_t count, const std::vector<TrackerBackend *> &backends, const std::function<void()> &setup,
+    const std::function<bool(size_t, TrackerBackend &)> &job)
+{
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&](TrackerBackend *backend)
+    {
+        if (setup) setup();
+        for (size_t index = next++; index < count && !failed; index = next++)
+        {
+            if (!job(index, *backend)) failed = true;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (TrackerBackend *backend : backends) threads.push_back(std::thread(worker, backend));
+    for (std::thread &thread : threads) thread.join();
+    return !failed;
+}
+
+/**
+ * Tracks the box from the frame first to the frame last, in either
+ * direction, decoding the frames reduced by up to maxscale. track gets the
+ * boxes of the frames after first, up to last.
+ */
+bool trackFrames(FrameSource &frames, TrackerBackend &backend, int maxscale, int first, int last, const BoundingBox &start,
+    std::vector<BoundingBox> &track)
+{
+    int step = last >= first ? 1 : -1;
+    std::unique_ptr<ObjectTracker> tracker = backend.createTracker();
+    BoundingBox bbox = start;
+    track.clear();
+    for (int i = first; i != last + step; i += step)
+    {
+        int scale = i == first ? backend.reducedScale(bbox, maxscale) : tracker->reducedScale(maxscale);
+        cv::Mat image = frames.readReduced(i, scale);
+        if (image.empty())
+        {
+            printf("Tracker could not read frame %d\n", i);
+            return false;
+        }
+        if (i == first)
+        {
+            tracker->init(image, bbox, scale);
+            continue;
+        }
+        backend.track(*tracker, image, bbox, scale);
+        track.push_back(bbox);
+    }
+    return true;
+}
+
+BoundingBox blend(const BoundingBox &a, double wa, const BoundingBox &b, double wb)
+{
+    double sum = wa + wb;
+    BoundingBox box;
+    box.x1_ = (a.x1_ * wa + b.x1_ * wb) / sum;
+    box.y1_ = (a.y1_ * wa + b.y1_ * wb) / sum;
+    box.x2_ = (a.x2_ * wa + b.x2_ * wb) / sum;
+    box.y2_ = (a.y2_ * wa + b.y2_ * wb) / sum;
+    return box;
+}
+
+}
+
+double boxOverlap(const BoundingBox &a, const BoundingBox &b)
+{
+    double intersection = a.compute_intersection(b);
+    double area = a.get_area() + b.get_area() - intersection;
+    return area > 0 ? intersection / area : 0.0;
+}
+
+std::vector<TrackingSegment> splitAtKeyframes(const std::vector<BoundingBox> &staged, int first, int last)
+{
+    std::vector<TrackingSegment> segments;
+    for (int i = first; i <= last; i++)
+    {
+        if (isEmpty(staged[i])) continue;
+        if (!segments.empty()) segments.back().last = i - 1;
+        segments.push_back({ i, last, staged[i] });
+    }
+    return segments;
+}
+
+std::vector<TrackingGap> findGaps(const std::vector<BoundingBox> &staged, int first, int last)
+{
+    std::vector<TrackingGap> gaps;
+    int previous = -1;
+    for (int i = first; i <= last; i++)
+    {
+        if (isEmpty(staged[i])) continue;
+        if (previous >= 0 && i - previous > 1) gaps.push_back({ previous, i });
+        previous = i;
+    }
+    return gaps;
+}
+
+int trackSegments(FrameSource &frames, const std::vector<TrackingSegment> &segments,
+    const std::vector<TrackerBackend *> &backends, int maxscale, std::function<void()> setup, std::vector<BoundingBox> &boxes)
+{
+    // the longest segments are started first, so the workers finish at about the same time
+    std::vector<TrackingSegment> queue(segments);
+    std::stable_sort(queue.begin(), queue.end(), [](const TrackingSegment &a, const TrackingSegment &b)
+    {
+        return a.last - a.first > b.last - b.first;
+    });
+
+    bool tracked = runWorkers(queue.size(), backends, setup, [&](size_t index, TrackerBackend &backend)
+    {
+        // the segments are disjoint, so the workers write different boxes
+        const TrackingSegment &segment = queue[index];
+        std::vector<BoundingBox> track;
+        if (!trackFrames(frames, backend, maxscale, segment.first, segment.last, segment.start, track)) return false;
+        boxes[segment.first] = segment.start;
+        std::copy(track.begin(), track.end(), boxes.begin() + segment.first + 1);
+        return true;
+    });
+    return tracked ? 0 : 1;
+}
+
+int fillGaps(FrameSource &frames, const std::vector<BoundingBox> &keyframes, const std::vector<TrackingGap> &gaps,
+    const std::vector<TrackerBackend *> &backends, int maxscale, std::function<void()> setup, std::vector<BoundingBox> &boxes)
+{
+    std::vector<TrackingGap> queue(gaps);
+    std::stable_sort(queue.begin(), queue.end(), [](const TrackingGap &a, const TrackingGap &b)
+    {
+        return a.to - a.from > b.to - b.from;
+    });
+    std::vector<BoundingBox> left, right;
+    for (const TrackingGap &gap : queue)
+    {
+        left.push_back(keyframes[gap.from]);
+        right.push_back(keyframes[gap.to]);
+    }
+
+    // the forward (even) and backward (odd) tracks of a gap are consecutive jobs, so they run concurrently
+    std::vector<std::vector<BoundingBox>> tracks(2 * queue.size());
+    bool tracked = runWorkers(tracks.size(), backends, setup, [&](size_t index, TrackerBackend &backend)
+    {
+        const TrackingGap &gap = queue[index / 2];
+        if (index % 2 == 0) return trackFrames(frames, backend, maxscale, gap.from, gap.to, left[index / 2], tracks[index]);
+        return trackFrames(frames, backend, maxscale, gap.to, gap.from, right[index / 2], tracks[index]);
+    });
+    if (!tracked) return 1;
+
+    for (size_t g = 0; g < queue.size(); g++)
+    {
+        const TrackingGap &gap = queue[g];
+        const std::vector<BoundingBox> &forward = tracks[2 * g];
+        const std::vector<BoundingBox> &backward = tracks[2 * g + 1];
+        // each track ends on the keyframe the other one starts from
+        double forwardconfidence = boxOverlap(forward.back(), right[g]);
+        double backwardconfidence = boxOverlap(backward.back(), left[g]);
+        bool lost = std::max(forwardconfidence, backwardconfidence) < MIN_TRACK_CONFIDENCE;
+        printf("Filled frames %d-%d, forward confidence %.3f, backward confidence %.3f%s\n", gap.from + 1, gap.to - 1,
+            forwardconfidence, backwardconfidence, lost ? ", tracks lost, interpolated" : "");
+
+        int length = gap.to - gap.from;
+        for (int i = gap.from + 1; i < gap.to; i++)
+        {
+            double t = (i - gap.from) / (double)length;
+            if (lost)
+            {
+                boxes[i] = blend(left[g], 1.0 - t, right[g], t);
+                continue;
+            }
+            // the backward track is stored from the right keyframe
+            const BoundingBox &forwardbox = forward[i - gap.from - 1];
+            const BoundingBox &backwardbox = backward[gap.to - i - 1];
+            boxes[i] = blend(forwardbox, (1.0 - t) * (CONFIDENCE_FLOOR + forwardconfidence),
+                backwardbox, t * (CONFIDENCE_FLOOR + backwardconfidence));
+        }
+    }
+    return 0;
+}
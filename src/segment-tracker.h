@@ -0,0 +1,77 @@
+#ifndef SEGMENT_TRACKER_H
+#define SEGMENT_TRACKER_H
+
+#include "frame-source.h"
+#include "tracker-backend.h"
+#include "helper/bounding_box.h"
+#include <functional>
+#include <vector>
+
+/**
+ * Frames tracked from a keyframe - the frame with a staged box - up to the
+ * frame before the next keyframe.
+ */
+struct TrackingSegment
+{
+    int first;
+    int last;
+    BoundingBox start;
+};
+
+/**
+ * Frames strictly between the keyframes from and to, which have no staged
+ * boxes.
+ */
+struct TrackingGap
+{
+    int from;
+    int to;
+};
+
+/// Returns the intersection over union of the boxes
+double boxOverlap(const BoundingBox &a, const BoundingBox &b);
+
+/**
+ * Splits the frames [first, last] at the frames with staged boxes. Each
+ * segment starts at a keyframe, the frames before the first keyframe are
+ * not covered.
+ */
+std::vector<TrackingSegment> splitAtKeyframes(const std::vector<BoundingBox> &staged, int first, int last);
+
+/// Returns the gaps between the consecutive keyframes in the frames [first, last]
+std::vector<TrackingGap> findGaps(const std::vector<BoundingBox> &staged, int first, int last);
+
+/**
+ * Tracks the segments concurrently, one worker thread per tracker backend.
+ *
+ * The segments do not depend on each other, so each worker takes the next
+ * untracked segment (the longest first) and tracks it with a tracker of
+ * its own backend. The GOTURN backends should share the read-only weights
+ * of their regressors where the inference backend allows it. setup is called in each worker
+ * thread before tracking (e.g. to configure thread-local state of the
+ * inference backend). The boxes of the segment frames are written to
+ * boxes, which must cover all frames. The frames are decoded reduced by up
+ * to maxscale, as in ObjectTracker::reducedScale(). frames must be safe to
+ * read from multiple threads. Returns 0 on success.
+ */
+int trackSegments(FrameSource &frames, const std::vector<TrackingSegment> &segments,
+    const std::vector<TrackerBackend *> &backends, int maxscale, std::function<void()> setup, std::vector<BoundingBox> &boxes);
+
+/**
+ * Fills the gaps between the keyframes with the fusion of a forward and a
+ * backward track.
+ *
+ * Each gap is tracked forward from the box of its left keyframe and
+ * backward from the box of its right keyframe, with the tracks of all gaps
+ * running concurrently like in trackSegments(). The confidence of a track
+ * is its overlap with the keyframe box it arrives at, and in each frame
+ * the tracks are averaged with their confidences weighted by the distance
+ * from the keyframe they start from. If neither track reaches its keyframe,
+ * the gap is interpolated linearly. The keyframe boxes are read from
+ * keyframes, the fused boxes are written to boxes (which may be the same
+ * vector). Returns 0 on success.
+ */
+int fillGaps(FrameSource &frames, const std::vector<BoundingBox> &keyframes, const std::vector<TrackingGap> &gaps,
+    const std::vector<TrackerBackend *> &backends, int maxscale, std::function<void()> setup, std::vector<BoundingBox> &boxes);
+
+#endif
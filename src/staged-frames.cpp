@@ -0,0 +1,132 @@
+#include "staged-frames.h"
+#include <iterator>
+
+static bool emptyBox(const BoundingBox &box)
+{
+    return box.x1_ == 0 && box.y1_ == 0 && box.x2_ == 0 && box.y2_ == 0;
+}
+
+void StagedFrames::resize(int frames)
+{
+    if (frames < this->frames) set(frames, this->frames - 1, false);
+    this->frames = frames;
+    bits.resize((frames + 63) / 64, 0);
+}
+
+void StagedFrames::rebuild(const std::vector<BoundingBox> &boxes)
+{
+    frames = boxes.size();
+    bits.assign((frames + 63) / 64, 0);
+    runs.clear();
+    for (int frame = 0; frame < frames;)
+    {
+        if (emptyBox(boxes[frame]))
+        {
+            frame++;
+            continue;
+        }
+        int last = frame;
+        while (last + 1 < frames && !emptyBox(boxes[last + 1])) last++;
+        set(frame, last, true);
+        frame = last + 1;
+    }
+}
+
+void StagedFrames::set(int first, int last, bool staged)
+{
+    if (first > last) return;
+
+    // whole words are filled at once, the partial ones at the ends are masked
+    for (int word = first / 64; word <= last / 64; word++)
+    {
+        int from = word == first / 64 ? first % 64 : 0;
+        int to = word == last / 64 ? last % 64 : 63;
+        uint64_t mask = (to - from == 63) ? ~0ull : (((1ull << (to - from + 1)) - 1) << from);
+        if (staged) bits[word] |= mask;
+        else bits[word] &= ~mask;
+    }
+
+    // the range is cut out of the runs, splitting the runs crossing its ends
+    auto run = runs.upper_bound(first);
+    if (run != runs.begin())
+    {
+        auto previous = std::prev(run);
+        if (previous->second >= first)
+        {
+            int end = previous->second;
+            if (previous->first == first) runs.erase(previous);
+            else previous->second = first - 1;
+            if (end > last) runs[last + 1] = end;
+        }
+    }
+    for (run = runs.lower_bound(first); run != runs.end() && run->first <= last;)
+    {
+        if (run->second > last) runs[last + 1] = run->second;
+        run = runs.erase(run);
+    }
+    if (!staged) return;
+
+    // the staged range is merged with the adjacent runs
+    int start = first, end = last;
+    auto next = runs.find(last + 1);
+    if (next != runs.end())
+    {
+        end = next->second;
+        runs.erase(next);
+    }
+    auto after = runs.lower_bound(first);
+    if (after != runs.begin() && std::prev(after)->second == first - 1)
+    {
+        start = std::prev(after)->first;
+        runs.erase(std::prev(after));
+    }
+    runs[start] = end;
+}
+
+void StagedFrames::set(int frame, bool staged)
+{
+    if (this->staged(frame) != staged) set(frame, frame, staged);
+}
+
+void StagedFrames::update(int frame, const BoundingBox &box)
+{
+    set(frame, !emptyBox(box));
+}
+
+void StagedFrames::update(int first, int last, const std::vector<BoundingBox> &boxes)
+{
+    for (int frame = first; frame <= last;)
+    {
+        bool staged = !emptyBox(boxes[frame]);
+        int end = frame;
+        while (end + 1 <= last && emptyBox(boxes[end + 1]) != staged) end++;
+        set(frame, end, staged);
+        frame = end + 1;
+    }
+}
+
+bool StagedFrames::staged(int frame) const
+{
+    return (bits[frame / 64] >> (frame % 64)) & 1;
+}
+
+std::map<int, int>::const_iterator StagedFrames::runAt(int frame) const
+{
+    auto run = runs.upper_bound(frame);
+    if (run == runs.begin()) return runs.end();
+    run = std::prev(run);
+    return run->second >= frame ? run : runs.end();
+}
+
+bool StagedFrames::allStaged(int first, int last) const
+{
+    return firstUnstaged(first, last) == -1;
+}
+
+int StagedFrames::firstUnstaged(int first, int last) const
+{
+    if (first > last) return -1;
+    auto run = runAt(first);
+    if (run == runs.end()) return first;
+    return run->second >= last ? -1 : run->second + 1;
+}
@@ -0,0 +1,55 @@
+#ifndef STAGED_FRAMES_H
+#define STAGED_FRAMES_H
+
+#include "helper/bounding_box.h"
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/**
+ * Index of the staged frames of an object - a bitset with one bit per frame
+ * and the set of maximal runs of consecutive staged frames.
+ *
+ * Checking a single frame takes one bit lookup, and checking whether a range
+ * is fully staged or finding its first unstaged frame takes one lookup in
+ * the runs, regardless of the length of the range. The ranges are
+ * inclusive.
+ */
+class StagedFrames
+{
+public:
+    /// Resizes the index to the number of frames, the added frames are unstaged
+    void resize(int frames);
+
+    /// Rebuilds the index from the boxes, the frames with non-zero boxes are staged
+    void rebuild(const std::vector<BoundingBox> &boxes);
+
+    /// Marks the frames from first to last as staged or unstaged
+    void set(int first, int last, bool staged);
+    void set(int frame, bool staged);
+
+    /// Updates the frame from its box, a box with all coordinates zero is unstaged
+    void update(int frame, const BoundingBox &box);
+
+    /// Updates the frames from first to last from the boxes, one range at a time
+    void update(int first, int last, const std::vector<BoundingBox> &boxes);
+
+    bool staged(int frame) const;
+
+    /// Checks if all frames from first to last are staged
+    bool allStaged(int first, int last) const;
+
+    /// Returns the first unstaged frame from first to last, or -1 if all of them are staged
+    int firstUnstaged(int first, int last) const;
+
+private:
+    /// The run containing the frame, or runs.end()
+    std::map<int, int>::const_iterator runAt(int frame) const;
+
+    int frames = 0;
+    std::vector<uint64_t> bits;
+    /// First frame of each run mapped to its last frame
+    std::map<int, int> runs;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "tracker-backend.h"
+
+BoundingBox scaleBox(const BoundingBox &bbox, double factor)
+{
+    BoundingBox scaled;
+    scaled.x1_ = bbox.x1_ * factor;
+    scaled.y1_ = bbox.y1_ * factor;
+    scaled.x2_ = bbox.x2_ * factor;
+    scaled.y2_ = bbox.y2_ * factor;
+    return scaled;
+}
+
+const ObjectTracker::State &ObjectTracker::state() const
+{
+    return current;
+}
+
+void ObjectTracker::restore(const State &state)
+{
+    current = state;
+}
+
+void TrackerBackend::track(const std::vector<ObjectTracker *> &trackers, const cv::Mat &image, std::vector<BoundingBox> &bboxes,
+    int scale)
+{
+    ScopedTimer timer;
+    trackObjects(trackers, image, bboxes, scale);
+    stats.add(timer.stop());
+}
+
+void TrackerBackend::track(ObjectTracker &tracker, const cv::Mat &image, BoundingBox &bbox, int scale)
+{
+    std::vector<BoundingBox> bboxes;
+    track(std::vector<ObjectTracker *>(1, &tracker), image, bboxes, scale);
+    bbox = bboxes[0];
+}
+
+const LatencyStats &TrackerBackend::latency() const
+{
+    return stats;
+}
+
+void TrackerBackend::printLatency() const
+{
+    stats.print("Tracker (" + name() + ")");
+}
@@ -0,0 +1,106 @@
+#ifndef TRACKER_BACKEND_H
+#define TRACKER_BACKEND_H
+
+#include "helper/bounding_box.h"
+#include "latency-stats.h"
+#include <opencv2/core/core.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Largest scale of the reduced decoding of the tracked frames (1/8 is the smallest JPEG scaled decoding)
+const int MAX_REDUCED_SCALE = 8;
+
+/// Returns the box with the coordinates multiplied by factor
+BoundingBox scaleBox(const BoundingBox &bbox, double factor);
+
+/**
+ * Tracker of a single object, created by a TrackerBackend.
+ *
+ * The images can be downscaled by an integer scale (e.g. decoded at a
+ * reduced size), the boxes are always in the full resolution coordinates.
+ */
+class ObjectTracker
+{
+public:
+    /**
+     * Everything the next step depends on - the data the backend keeps from
+     * the previous frame, and the box in it. The data is never modified
+     * after the step, so the states can be checkpointed without copying.
+     */
+    struct State
+    {
+        cv::Mat data;
+        BoundingBox box;
+    };
+
+    virtual ~ObjectTracker() {}
+
+    /// Starts tracking the box in the image downscaled by scale
+    virtual void init(const cv::Mat &image, const BoundingBox &bbox, int scale = 1) = 0;
+
+    /**
+     * Returns the largest scale (1, 2, 4 or 8, up to maxscale) the next
+     * image can be downscaled by without losing precision.
+     */
+    virtual int reducedScale(int maxscale) const = 0;
+
+    /// Returns the current state, which shares the data with the tracker
+    const State &state() const;
+
+    /**
+     * Continues from the state saved after tracking some frame, the next
+     * steps give exactly the boxes the uninterrupted tracker would give.
+     */
+    void restore(const State &state);
+
+protected:
+    State current;
+};
+
+/**
+ * Tracking method - creates the object trackers and steps them.
+ *
+ * A backend is used by one thread at a time, the parallel workers get
+ * their own backends. The latency of the steps is measured for all
+ * backends the same way.
+ */
+class TrackerBackend
+{
+public:
+    virtual ~TrackerBackend() {}
+
+    /// Name of the backend, used in reports
+    virtual std::string name() const = 0;
+
+    /// Creates a tracker of an object, stepped only by this backend
+    virtual std::unique_ptr<ObjectTracker> createTracker() = 0;
+
+    /// Returns the largest scale the image can be downscaled by to start tracking the box
+    virtual int reducedScale(const BoundingBox &bbox, int maxscale) const = 0;
+
+    /**
+     * Tracks the boxes of all trackers to the same next image. bboxes is set
+     * to the new locations, in the order of the trackers. The step is
+     * recorded as a single latency sample.
+     */
+    void track(const std::vector<ObjectTracker *> &trackers, const cv::Mat &image, std::vector<BoundingBox> &bboxes,
+        int scale = 1);
+
+    /// Tracks the box of the tracker to the next image, bbox is set to the new location
+    void track(ObjectTracker &tracker, const cv::Mat &image, BoundingBox &bbox, int scale = 1);
+
+    const LatencyStats &latency() const;
+
+    /// Prints the latency of the steps, labelled with the name of the backend
+    void printLatency() const;
+
+protected:
+    virtual void trackObjects(const std::vector<ObjectTracker *> &trackers, const cv::Mat &image,
+        std::vector<BoundingBox> &bboxes, int scale) = 0;
+
+private:
+    LatencyStats stats;
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "tracker-worker.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+
+bool sameBox(const BoundingBox &a, const BoundingBox &b)
+{
+    return a.x1_ == b.x1_ && a.y1_ == b.y1_ && a.x2_ == b.x2_ && a.y2_ == b.y2_;
+}
+
+}
+
+TrackerWorker::TrackerWorker(FrameSource &frames, TrackerBackend &backend, int lookahead, size_t checkpointbytes, int maxscale,
+    std::function<void()> setup)
+    : frames(frames),
+    backend(backend),
+    lookahead(lookahead),
+    maxscale(maxscale),
+    setup(setup),
+    checkpointsize(0),
+    checkpointbytes(checkpointbytes),
+    playhead(0),
+    enabled(true),
+    stopping(false)
+{
+    thread = std::thread(&TrackerWorker::run, this);
+}
+
+TrackerWorker::~TrackerWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        cond.notify_all();
+    }
+    thread.join();
+}
+
+int TrackerWorker::addObject()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tracks.push_back(Track());
+    tracks.back().results.resize(frames.size());
+    tracks.back().ready.resize(frames.size(), 0);
+    tracks.back().generations.resize(frames.size(), 0);
+    return tracks.size() - 1;
+}
+
+void TrackerWorker::reset(int object, int frame, const BoundingBox &bbox)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Track &track = tracks[object];
+    // the proposals of the current generation already continue from this box
+    if (track.active && track.ready[frame] && track.generations[frame] == track.generation && sameBox(track.results[frame], bbox))
+    {
+        return;
+    }
+    std::map<std::pair<int, int>, Checkpoint>::const_iterator saved = checkpoints.find(std::make_pair(object, frame));
+    track.restore = saved != checkpoints.end() && sameBox(saved->second.state.box, bbox);
+    if (track.restore) track.initstate = saved->second.state;
+
+    track.generation++;
+    // only the proposals downstream of the edited frame depend on it
+    std::fill(track.ready.begin() + frame + 1, track.ready.end(), 0);
+    track.results[frame] = bbox;
+    track.ready[frame] = 1;
+    track.generations[frame] = track.generation;
+    track.initpending = true;
+    track.initframe = frame;
+    track.initbox = bbox;
+    track.next = frame + 1;
+    track.active = true;
+    cond.notify_all();
+}
+
+void TrackerWorker::setPlayhead(int frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (playhead == frame) return;
+    playhead = frame;
+    cond.notify_all();
+}
+
+void TrackerWorker::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->enabled = enabled;
+    cond.notify_all();
+}
+
+bool TrackerWorker::proposal(int object, int frame, BoundingBox &bbox)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const Track &track = tracks[object];
+    if (!track.ready[frame]) return false;
+    bbox = track.results[frame];
+    return true;
+}
+
+bool TrackerWorker::pending(int object, int frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const Track &track = tracks[object];
+    return track.active && enabled && !track.ready[frame] && frame >= track.next && frame <= playhead + lookahead;
+}
+
+int TrackerWorker::collect(int object, std::vector<BoundingBox> &proposals)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Track &track = tracks[object];
+    int count = 0;
+    for (int frame : track.completed)
+    {
+        // skip the frames invalidated after they were computed
+        if (!track.ready[frame]) continue;
+        proposals[frame] = track.results[frame];
+        count++;
+    }
+    track.completed.clear();
+    return count;
+}
+
+void TrackerWorker::checkpoint(int object, int frame, const ObjectTracker::State &state)
+{
+    std::pair<int, int> key(object, frame);
+    std::map<std::pair<int, int>, Checkpoint>::iterator saved = checkpoints.find(key);
+    if (saved == checkpoints.end())
+    {
+        saved = checkpoints.insert(std::make_pair(key, Checkpoint())).first;
+    }
+    else
+    {
+        // a frame checkpointed again becomes the newest one
+        checkpointsize -= saved->second.state.data.total() * saved->second.state.data.elemSize();
+        checkpointorder.erase(saved->second.position);
+    }
+    saved->second.state = state;
+    saved->second.position = checkpointorder.insert(checkpointorder.end(), key);
+    checkpointsize += state.data.total() * state.data.elemSize();
+    while (checkpointsize > checkpointbytes && !checkpointorder.empty())
+    {
+        std::map<std::pair<int, int>, Checkpoint>::iterator oldest = checkpoints.find(checkpointorder.front());
+        checkpointorder.pop_front();
+        checkpointsize -= oldest->second.state.data.total() * oldest->second.state.data.elemSize();
+        checkpoints.erase(oldest);
+    }
+}
+
+bool TrackerWorker::due(const Track &track) const
+{
+    return track.active && track.next < (int)track.ready.size() && track.next <= playhead + lookahead;
+}
+
+bool TrackerWorker::hasWork() const
+{
+    if (!enabled) return false;
+    for (const Track &track : tracks)
+    {
+        if (track.active && (track.initpending || due(track))) return true;
+    }
+    return false;
+}
+
+void TrackerWorker::run()
+{
+    if (setup) setup();
+    while (true)
+    {
+        // the objects stepped in this iteration, with the generations they were started in
+        std::vector<int> objects;
+        std::vector<unsigned> generations;
+        bool init = false;
+        bool restore = false;
+        int frame = 0;
+        BoundingBox bbox;
+        ObjectTracker::State state;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return stopping || hasWork(); });
+            if (stopping) return;
+            while (trackers.size() < tracks.size()) trackers.push_back(backend.createTracker());
+
+            // initializations come first, they need no inference
+            for (size_t i = 0; i < tracks.size() && !init; i++)
+            {
+                Track &track = tracks[i];
+                if (!track.active || !track.initpending) continue;
+                init = true;
+                objects.push_back(i);
+                generations.push_back(track.generation);
+                frame = track.initframe;
+                bbox = track.initbox;
+                restore = track.restore;
+                state = track.initstate;
+                track.initpending = false;
+                track.initstate = ObjectTracker::State();
+            }
+
+            // otherwise the objects behind the others are tracked first, all of those on the same frame at once
+            if (!init)
+            {
+                frame = (int)frames.size();
+                for (const Track &track : tracks)
+                {
+                    if (due(track)) frame = std::min(frame, track.next);
+                }
+                for (size_t i = 0; i < tracks.size(); i++)
+                {
+                    if (!due(tracks[i]) || tracks[i].next != frame) continue;
+                    objects.push_back(i);
+                    generations.push_back(tracks[i].generation);
+                }
+            }
+        }
+
+        // the restored state does not need the frame
+        if (restore)
+        {
+            trackers[objects[0]]->restore(state);
+            continue;
+        }
+
+        // the frame is decoded at the largest scale none of the trackers loses detail at
+        int scale = init ? backend.reducedScale(bbox, maxscale) : maxscale;
+        if (!init)
+        {
+            for (int object : objects) scale = std::min(scale, trackers[object]->reducedScale(maxscale));
+        }
+        cv::Mat image = frames.readReduced(frame, scale);
+        if (image.empty())
+        {
+            printf("Tracker could not read frame %d\n", frame);
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < objects.size(); i++)
+            {
+                if (tracks[objects[i]].generation == generations[i]) tracks[objects[i]].active = false;
+            }
+            continue;
+        }
+
+        if (init)
+        {
+            trackers[objects[0]]->init(image, bbox, scale);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tracks[objects[0]].generation == generations[0]) checkpoint(objects[0], frame, trackers[objects[0]]->state());
+            continue;
+        }
+
+        std::vector<ObjectTracker *> stepped;
+        for (int object : objects) stepped.push_back(trackers[object].get());
+        std::vector<BoundingBox> bboxes;
+        backend.track(stepped, image, bboxes, scale);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            Track &track = tracks[objects[i]];
+            if (track.generation != generations[i]) continue;
+            track.results[frame] = bboxes[i];
+            track.ready[frame] = 1;
+            track.generations[frame] = track.generation;
+            checkpoint(objects[i], frame, trackers[objects[i]]->state());
+            track.completed.push_back(frame);
+            track.next = frame + 1;
+        }
+    }
+}
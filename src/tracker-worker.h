@@ -0,0 +1,135 @@
+#ifndef TRACKER_WORKER_H
+#define TRACKER_WORKER_H
+
+#include "frame-source.h"
+#include "tracker-backend.h"
+#include "helper/bounding_box.h"
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs the trackers of the objects in a background thread, ahead of the
+ * displayed frame.
+ *
+ * After reset() the worker initializes the tracker of the object with the
+ * given frame and bounding box, and tracks the consecutive frames until it
+ * gets lookahead frames ahead of the playhead. The UI only displays already
+ * computed proposals, so playback is never slowed down by the tracker.
+ *
+ * All objects due on the same frame are tracked together, in a single step
+ * of the backend (a batched forward pass of the network with GOTURN). An
+ * object reset behind the others is tracked alone until it catches up with
+ * them.
+ *
+ * Each reset() starts a new generation of the object - its proposals for
+ * the frames after the reset frame are invalidated and computed again,
+ * while proposals for the earlier frames are kept. Results of tracking
+ * started in an older generation are discarded.
+ *
+ * The tracker state after each tracked frame is checkpointed, within a
+ * memory budget (the least recently checkpointed frames are dropped first).
+ * Resetting to the box the tracker already had in the frame - e.g.
+ * initializing with a proposal - does not start over: if the frame belongs
+ * to the current generation nothing changes, otherwise the checkpoint is
+ * restored without decoding the frame. Either way the proposals are exactly those of an
+ * uninterrupted run.
+ */
+class TrackerWorker
+{
+public:
+    /**
+     * frames must be safe to read from multiple threads. setup is called
+     * in the worker thread before any tracking is done (e.g. to configure
+     * thread-local state of the inference backend). checkpointbytes limits
+     * the memory of the tracker checkpoints. The frames are decoded reduced
+     * by up to maxscale, as in ObjectTracker::reducedScale().
+     */
+    TrackerWorker(FrameSource &frames, TrackerBackend &backend, int lookahead, size_t checkpointbytes, int maxscale,
+        std::function<void()> setup);
+    ~TrackerWorker();
+
+    /// Adds an object with no box to track, returns its index
+    int addObject();
+
+    /// Restarts tracking of the object from the frame with the given bounding box
+    void reset(int object, int frame, const BoundingBox &bbox);
+
+    /// Sets the displayed frame, the worker tracks up to lookahead frames ahead of it
+    void setPlayhead(int frame);
+
+    /// Pauses (false) or resumes (true) tracking
+    void setEnabled(bool enabled);
+
+    /// Returns true and the proposal if it is computed for the object in the frame
+    bool proposal(int object, int frame, BoundingBox &bbox);
+
+    /// Returns true if the proposal for the object in the frame is not ready yet, but will be computed
+    bool pending(int object, int frame);
+
+    /**
+     * Copies proposals of the object computed since the last call to
+     * proposals, returns the number of copied frames.
+     */
+    int collect(int object, std::vector<BoundingBox> &proposals);
+
+private:
+    /// Tracking state of an object, guarded by the mutex
+    struct Track
+    {
+        std::vector<BoundingBox> results;
+        std::vector<char> ready;
+        /// Generation each proposal was computed in
+        std::vector<unsigned> generations;
+        std::vector<int> completed;
+        unsigned generation = 0;
+        bool initpending = false;
+        int initframe = 0;
+        BoundingBox initbox;
+        /// Set with initpending if the initialization restores the checkpoint of the frame
+        bool restore = false;
+        ObjectTracker::State initstate;
+        int next = 0;
+        bool active = false;
+    };
+
+    void run();
+    void checkpoint(int object, int frame, const ObjectTracker::State &state);
+    bool due(const Track &track) const;
+    bool hasWork() const;
+
+    FrameSource &frames;
+    TrackerBackend &backend;
+    /// Trackers of the objects, created by the backend, only used by the worker thread
+    std::vector<std::unique_ptr<ObjectTracker>> trackers;
+    const int lookahead;
+    const int maxscale;
+    std::function<void()> setup;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<Track> tracks;
+    /// Tracker state after the (object, frame) step, with its position in checkpointorder
+    struct Checkpoint
+    {
+        ObjectTracker::State state;
+        std::list<std::pair<int, int>>::iterator position;
+    };
+
+    /// Tracker states after the (object, frame) steps, and their order for dropping the oldest
+    std::map<std::pair<int, int>, Checkpoint> checkpoints;
+    std::list<std::pair<int, int>> checkpointorder;
+    size_t checkpointsize;
+    const size_t checkpointbytes;
+    int playhead;
+    bool enabled;
+    bool stopping;
+    std::thread thread;
+};
+
+#endif
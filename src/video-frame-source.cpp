@@ -0,0 +1,259 @@
+#include "video-frame-source.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace
+{
+
+const char SEEK_INDEX_MAGIC[8] = {'V', 'I', 'D', 'S', 'E', 'E', 'K', '\0'};
+const uint32_t SEEK_INDEX_VERSION = 1;
+
+struct SeekIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t framecount;
+    int64_t videosize;
+    int64_t videomtime;
+};
+
+bool videoSignature(const std::string &videoname, int64_t &size, int64_t &mtime)
+{
+    struct stat st;
+    if (stat(videoname.c_str(), &st) != 0) return false;
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+}
+
+VideoFrameSource::VideoFrameSource(cv::Size framesize, int segmentlength, int cachedsegments)
+    : framesize(framesize),
+    segmentlength(std::max(1, segmentlength)),
+    cachedsegments(std::max(1, cachedsegments)),
+    position(0)
+{
+}
+
+int VideoFrameSource::open(const std::string &videoname)
+{
+    this->videoname = videoname;
+    std::string indexpath = videoname + ".seekidx";
+    if (loadIndex(indexpath) != 0 && buildIndex(indexpath) != 0) return 1;
+
+    capture.open(videoname, cv::CAP_FFMPEG);
+    if (!capture.isOpened())
+    {
+        printf("Error opening video stream or file\n");
+        return 1;
+    }
+    position = 0;
+    return timestamps.empty() ? 1 : 0;
+}
+
+int VideoFrameSource::loadIndex(const std::string &indexpath)
+{
+    std::ifstream file(indexpath, std::ios::binary);
+    if (!file.good()) return 1;
+    SeekIndexHeader header;
+    int64_t videosize, videomtime;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, SEEK_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SEEK_INDEX_VERSION ||
+        !videoSignature(videoname, videosize, videomtime) ||
+        header.videosize != videosize || header.videomtime != videomtime)
+    {
+        printf("Seek index %s is outdated, rebuilding\n", indexpath.c_str());
+        return 1;
+    }
+    timestamps.resize(header.framecount);
+    if (!file.read(reinterpret_cast<char *>(timestamps.data()), timestamps.size() * sizeof(double)))
+    {
+        timestamps.clear();
+        return 1;
+    }
+    printf("Loaded seek index with %d frames from %s\n", (int)timestamps.size(), indexpath.c_str());
+    return 0;
+}
+
+int VideoFrameSource::buildIndex(const std::string &indexpath)
+{
+    printf("Building seek index for %s...\n", videoname.c_str());
+    cv::VideoCapture cap(videoname, cv::CAP_FFMPEG);
+    if (!cap.isOpened())
+    {
+        printf("Error opening video stream or file\n");
+        return 1;
+    }
+    timestamps.clear();
+    while (cap.grab())
+    {
+        timestamps.push_back(cap.get(cv::CAP_PROP_POS_MSEC));
+        if (timestamps.size() % 1000 == 0) printf("Indexed frames:  %d\n", (int)timestamps.size());
+    }
+    cap.release();
+
+    SeekIndexHeader header;
+    memcpy(header.magic, SEEK_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SEEK_INDEX_VERSION;
+    header.framecount = timestamps.size();
+    if (!videoSignature(videoname, header.videosize, header.videomtime)) return 1;
+
+    std::ofstream file(indexpath, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(timestamps.data()), timestamps.size() * sizeof(double));
+    if (!file.good())
+    {
+        // the index is still usable for this session
+        printf("Could not save seek index to %s\n", indexpath.c_str());
+    }
+    else printf("Seek index with %d frames saved to %s\n", (int)timestamps.size(), indexpath.c_str());
+    return 0;
+}
+
+int VideoFrameSource::size() const
+{
+    return timestamps.size();
+}
+
+int VideoFrameSource::locate(double timestamp) const
+{
+    if (timestamps.empty()) return -1;
+    double tolerance = 0.5;
+    if (timestamps.size() > 1)
+    {
+        tolerance = 0.5 * (timestamps.back() - timestamps.front()) / (timestamps.size() - 1);
+    }
+    auto it = std::lower_bound(timestamps.begin(), timestamps.end(), timestamp);
+    int best = -1;
+    double bestdistance = tolerance;
+    if (it != timestamps.end() && std::abs(*it - timestamp) <= bestdistance)
+    {
+        best = it - timestamps.begin();
+        bestdistance = std::abs(*it - timestamp);
+    }
+    if (it != timestamps.begin() && std::abs(*(it - 1) - timestamp) <= bestdistance)
+    {
+        best = it - 1 - timestamps.begin();
+    }
+    return best;
+}
+
+bool VideoFrameSource::trySeek(int anchor, int frame, cv::Mat &image)
+{
+    capture.set(cv::CAP_PROP_POS_FRAMES, anchor);
+    if (!capture.read(image)) return false;
+    int actual = locate(capture.get(cv::CAP_PROP_POS_MSEC));
+    if (actual < 0 || actual > frame) return false;
+    validatedseeks[anchor] = actual;
+    position = actual + 1;
+    return true;
+}
+
+bool VideoFrameSource::seekBefore(int frame, cv::Mat &image)
+{
+    int anchor = frame;
+    // the anchors back off exponentially, so there are only logarithmically many attempts
+    for (long long step = segmentlength; anchor > 0; step *= 2)
+    {
+        if (trySeek(anchor, frame, image)) return true;
+        // the container seeked past the requested frame, retry from an earlier anchor
+        anchor = (int)std::max(0LL, anchor - step);
+    }
+
+    // the nearest anchor that was validated before to land at or before the frame
+    for (auto it = validatedseeks.upper_bound(frame); it != validatedseeks.begin();)
+    {
+        --it;
+        if (it->second <= frame && trySeek(it->first, frame, image)) return true;
+    }
+
+    // decoding from the beginning of the video is always exact, but only used when no anchor worked
+    capture.release();
+    capture.open(videoname, cv::CAP_FFMPEG);
+    position = 0;
+    if (!capture.isOpened() || !capture.read(image)) return false;
+    position = 1;
+    return true;
+}
+
+cv::Mat VideoFrameSource::prepare(const cv::Mat &image) const
+{
+    if (framesize.area() == 0 || image.size() == framesize) return image.clone();
+    cv::Mat resized;
+    cv::resize(image, resized, framesize);
+    return resized;
+}
+
+bool VideoFrameSource::decodeSegment(int segment, std::vector<cv::Mat> &decoded)
+{
+    int start = segment * segmentlength;
+    int end = std::min(start + segmentlength, size());
+    decoded.assign(end - start, cv::Mat());
+
+    cv::Mat image;
+    int current = -1;
+    // continue the sequential decoding if the segment is just ahead, seek otherwise
+    if (!(position >= 0 && position <= start && start - position < segmentlength))
+    {
+        if (!seekBefore(start, image)) return false;
+        current = position - 1;
+    }
+    while (true)
+    {
+        if (current >= start) decoded[current - start] = prepare(image);
+        if (current + 1 >= end) break;
+        if (!capture.read(image))
+        {
+            printf("Failed to decode frame %d from %s\n", position, videoname.c_str());
+            // the decoder state is unknown, force seeking on the next read, which
+            // happens only if the incomplete segment is not cached
+            position = -1;
+            return true;
+        }
+        current = position++;
+    }
+
+    segments[segment] = decoded;
+    recentsegments.push_front(segment);
+    while ((int)recentsegments.size() > cachedsegments)
+    {
+        segments.erase(recentsegments.back());
+        recentsegments.pop_back();
+    }
+    return true;
+}
+
+cv::Mat VideoFrameSource::read(int index)
+{
+    if (index < 0 || index >= size()) return cv::Mat();
+    int segment = index / segmentlength;
+    auto it = segments.find(segment);
+    if (it != segments.end())
+    {
+        recentsegments.remove(segment);
+        recentsegments.push_front(segment);
+        return it->second[index - segment * segmentlength];
+    }
+    std::vector<cv::Mat> decoded;
+    if (!decodeSegment(segment, decoded)) return cv::Mat();
+    return decoded[index - segment * segmentlength];
+}
+
+bool VideoFrameSource::readEncoded(int index, std::vector<uchar> &data)
+{
+    cv::Mat image = read(index);
+    if (image.empty()) return false;
+    return cv::imencode(".jpg", image, data);
+}
+
+std::string VideoFrameSource::name(int index) const
+{
+    return videoname + "#" + std::to_string(index);
+}
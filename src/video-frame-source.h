@@ -0,0 +1,73 @@
+#ifndef VIDEO_FRAME_SOURCE_H
+#define VIDEO_FRAME_SOURCE_H
+
+#include "frame-source.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <list>
+#include <map>
+
+/**
+ * Frames decoded on demand directly from the video file.
+ *
+ * On the first use the whole video is scanned once and the seek index -
+ * the number of frames and the presentation timestamp of every frame - is
+ * stored next to the video as <video>.seekidx. Later runs load the index
+ * instantly, as long as the video file has not changed.
+ *
+ * The frames are grouped in segments of consecutive frames starting at
+ * seek anchors. Reading a frame decodes its whole segment, starting from
+ * the anchor, and keeps the decoded segment in a small LRU cache, so
+ * stepping backwards or forwards around the current frame and jumping
+ * back to recently visited frames does not require seeking again.
+ * After each seek the position reported by the decoder is validated
+ * against the index, so inaccurate container seeking never results in
+ * returning a wrong frame. When the anchors near the frame fail, the
+ * nearest anchor validated by an earlier seek is used, and the video is
+ * decoded from the beginning only if there is none.
+ */
+class VideoFrameSource : public FrameSource
+{
+public:
+    VideoFrameSource(cv::Size framesize, int segmentlength, int cachedsegments);
+
+    /// Opens the video and loads or builds its seek index, returns 0 on success
+    int open(const std::string &videoname);
+
+    int size() const override;
+    cv::Mat read(int index) override;
+    bool readEncoded(int index, std::vector<uchar> &data) override;
+    bool storesEncoded() const override { return false; }
+    std::string name(int index) const override;
+
+private:
+    int loadIndex(const std::string &indexpath);
+    int buildIndex(const std::string &indexpath);
+    int locate(double timestamp) const;
+    /**
+     * Decodes the frames of the segment, the segment is cached only if all
+     * of them were decoded. Returns false if no frame could be decoded.
+     */
+    bool decodeSegment(int segment, std::vector<cv::Mat> &decoded);
+    bool trySeek(int anchor, int frame, cv::Mat &image);
+    bool seekBefore(int frame, cv::Mat &image);
+    cv::Mat prepare(const cv::Mat &image) const;
+
+    cv::VideoCapture capture;
+    std::string videoname;
+    cv::Size framesize;
+    int segmentlength;
+    int cachedsegments;
+
+    std::vector<double> timestamps;
+
+    /// Index of the next frame returned by the decoder
+    int position;
+
+    /// Anchors whose seeks landed at or before the requested frame, mapped to the frame they landed at
+    std::map<int, int> validatedseeks;
+
+    std::list<int> recentsegments;
+    std::map<int, std::vector<cv::Mat>> segments;
+};
+
+#endif